@@ -0,0 +1,47 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <sys/types.h>
+#include <SDL.h>
+
+#define ARCHIVE_THREADS 2
+// Indexes of the most recently opened archives kept in memory
+#define ARCHIVE_CACHE_SIZE 8
+#define ARCHIVE_READ_BUFFER (256 << 10)
+#define TAR_BLOCK_SIZE 512
+// Largest GNU long name or pax header that is read, bigger ones mean a corrupt archive
+#define TAR_MAX_METADATA_SIZE (1 << 20)
+
+// A file or directory inside an archive. Directories the archive only implies
+// through the paths below them are added with mode 040755 and mtime 0.
+typedef struct ArchiveEntry {
+    std::string name;
+    uint64_t size;
+    int64_t mtime;
+    mode_t mode;
+    bool is_dir;
+    // Indexes into ArchiveIndex::entries, for directories
+    std::vector<uint32_t> children;
+} ArchiveEntry;
+
+// Every entry of one archive, entries[0] is its root. error is set when the
+// archive couldn't be read, entries then holds whatever came before the problem.
+typedef struct ArchiveIndex {
+    std::vector<ArchiveEntry> entries;
+    std::string error;
+} ArchiveIndex;
+
+void initArchives(Uint32 notify_event);
+void shutdownArchives();
+bool isArchiveName(std::string name);
+std::shared_ptr<const ArchiveIndex> getArchiveIndex(std::string path);
+const ArchiveEntry* findArchiveEntry(const ArchiveIndex* index, std::string inner_path);
+
+std::shared_ptr<ArchiveIndex> readTarIndex(std::string path);
+std::shared_ptr<ArchiveIndex> readZipIndex(std::string path);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdint.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "explorer.h"
+
+// Embedded by src/assets_data.S, each blob is followed by its length in <name>_size
+extern "C" {
+    extern const unsigned char asset_directory_icon[];
+    extern const uint64_t asset_directory_icon_size;
+    extern const unsigned char asset_executable_icon[];
+    extern const uint64_t asset_executable_icon_size;
+    extern const unsigned char asset_image_icon[];
+    extern const uint64_t asset_image_icon_size;
+    extern const unsigned char asset_video_icon[];
+    extern const uint64_t asset_video_icon_size;
+    extern const unsigned char asset_code_icon[];
+    extern const uint64_t asset_code_icon_size;
+    extern const unsigned char asset_other_icon[];
+    extern const uint64_t asset_other_icon_size;
+    extern const unsigned char asset_plus_icon[];
+    extern const uint64_t asset_plus_icon_size;
+    extern const unsigned char asset_minus_icon[];
+    extern const uint64_t asset_minus_icon_size;
+    extern const unsigned char asset_font[];
+    extern const uint64_t asset_font_size;
+}
+
+// Cells of the icon atlas, the first six follow the order of Type
+enum struct AtlasIcon {
+    DIRECTORY,
+    EXECUTABLE,
+    IMAGE,
+    VIDEO,
+    CODE,
+    OTHER,
+    PLUS,
+    MINUS
+};
+#define NUM_ATLAS_ICONS 8
+
+// Icons are scaled once into square cells of this size when the atlas is built, see batch.h
+#define ATLAS_CELL_SIZE 64
+
+SDL_Surface* loadEmbeddedIcon(AtlasIcon icon);
+TTF_Font* openEmbeddedFont(int point_size);
+AtlasIcon iconForType(Type type);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "assets.h"
+
+// Characters baked into the atlas, anything else is drawn as BATCH_MISSING_GLYPH
+#define BATCH_FIRST_GLYPH 32
+#define BATCH_LAST_GLYPH 255
+#define BATCH_MISSING_GLYPH '?'
+#define ATLAS_WIDTH (ATLAS_CELL_SIZE * NUM_ATLAS_ICONS)
+
+bool initBatchRenderer(SDL_Renderer *renderer, TTF_Font *font);
+void shutdownBatchRenderer();
+void beginBatch();
+void batchFill(SDL_Rect rect, SDL_Color color);
+void batchIcon(AtlasIcon icon, SDL_Rect dst);
+int batchText(const std::string& text, int x, int y, SDL_Color color);
+int measureText(const std::string& text);
+int submitBatch(SDL_Renderer *renderer);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+#include <SDL.h>
+#include "explorer.h"
+
+#define COMPARE_THREADS 8
+#define COMPARE_READ_SIZE (1 << 20)
+#define COMPARE_PROGRESS_INTERVAL_MS 100
+
+// Why an entry found in both trees is CHANGED, a changed node has at least one
+#define DIFF_REASON_SIZE 1
+#define DIFF_REASON_MTIME 2
+#define DIFF_REASON_MODE 4
+#define DIFF_REASON_TARGET 8
+#define DIFF_REASON_CONTENT 16
+
+// An entry of the merged tree. ADDED entries are only in the right tree, REMOVED
+// ones only in the left; an entry that is a directory on one side and not on the
+// other is two nodes, one of each. children is written once by the walker before
+// scanned is set and never changes after that. diff and reasons are only updated
+// afterwards by content checks.
+struct CompareNode {
+    std::string name;
+    CompareNode *parent;
+    bool is_dir;
+    std::atomic<DiffKind> diff;
+    std::atomic<uint8_t> reasons;
+    // Differences anywhere below this directory
+    std::atomic<uint32_t> changes;
+    // Metadata of the right entry, or the left one for REMOVED entries
+    uint64_t size;
+    int64_t mtime;
+    mode_t mode;
+    std::atomic<bool> scanned;
+    std::vector<CompareNode*> children;
+};
+
+typedef struct CompareProgress {
+    uint64_t entries;
+    uint64_t added;
+    uint64_t removed;
+    uint64_t changed;
+    uint64_t checks_pending;
+    uint64_t bytes_compared;
+    bool done;
+} CompareProgress;
+
+void startCompare(std::string left, std::string right, bool check_content, Uint32 notify_event);
+void stopCompare();
+CompareNode* getCompareRoot();
+std::string getCompareRootPath(bool right);
+bool getCompareContent();
+bool getCompareProgress(CompareProgress* progress);
+std::string getCompareNodePath(CompareNode* node, bool right);
+DiffKind getCompareNodeDiff(CompareNode* node);
+std::string getDiffReasonText(uint8_t reasons);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef DUPES_H
+#define DUPES_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <SDL.h>
+
+#define DUPES_THREADS 8
+// Files that match in size are first compared by a hash of their first and last blocks
+#define DUPES_BLOCK_SIZE 4096
+#define DUPES_READ_SIZE (1 << 20)
+#define DUPES_PROGRESS_INTERVAL_MS 100
+
+enum struct DupeStage {
+    LISTING,
+    PARTIAL_HASH,
+    FULL_HASH,
+    DONE
+};
+
+// Files with identical contents. Each copy is one inode, listed with every
+// path hard-linked to it, so only copies beyond the first waste space.
+typedef struct DuplicateGroup {
+    uint64_t size;
+    std::vector<std::vector<std::string>> copies;
+} DuplicateGroup;
+
+// Snapshot of the running scan, for the status bar. bytes_skipped counts the
+// file contents the size and partial hash stages ruled out without reading.
+typedef struct DuplicateProgress {
+    DupeStage stage;
+    uint64_t files;
+    uint64_t bytes_total;
+    uint64_t bytes_hashed;
+    uint64_t bytes_skipped;
+    uint64_t groups;
+    uint64_t bytes_wasted;
+} DuplicateProgress;
+
+void startDuplicateScan(std::string path, Uint32 notify_event);
+void stopDuplicateScan();
+bool getDuplicateProgress(DuplicateProgress* progress);
+bool popDuplicateGroup(DuplicateGroup* group);
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef EXPLORER_H
+#define EXPLORER_H
+
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define WIDTH 800
+#define HEIGHT 600
+
+#define COLUMN_HEADER_Y 55
+#define COLUMN_HEADER_HEIGHT 20
+#define FILES_TOP_MARGIN (COLUMN_HEADER_Y + COLUMN_HEADER_HEIGHT + 5)
+#define FILES_LEFT_MARGIN 40
+#define FILE_HEIGHT 30
+#define FILE_DEPTH_INDENT 10
+
+#define FILE_PERMISSIONS_X (WIDTH - 100)
+#define FILE_SIZE_X (FILE_PERMISSIONS_X - 100)
+#define FILE_MODIFIED_X (FILE_SIZE_X - 120)
+
+// Shown in the metadata columns until a lazy stat lands
+#define PENDING_STAT_TEXT "..."
+
+#define STATUS_BAR_HEIGHT 20
+
+#define SCROLLBAR_X WIDTH - 15
+#define SCROLLBAR_Y (FILES_TOP_MARGIN + 5)
+#define SCROLLBAR_HEIGHT (HEIGHT - SCROLLBAR_Y - STATUS_BAR_HEIGHT - 5)
+#define SCROLLBAR_HANDLE_RADIUS 5
+const SDL_Color SCROLLBAR_COLOR = {0, 0, 0, 255};
+const SDL_Color SCROLLBAR_HANDLE_COLOR = {200, 200, 200, 180};
+const SDL_Color SCROLLBAR_HANDLE_DRAG_COLOR = {200, 200, 200, 255};
+
+const SDL_Color SELECTION_COLOR = {180, 210, 245, 255};
+const SDL_Color STATUS_BAR_COLOR = {0xd9, 0xdb, 0xb9, 0xFF};
+const SDL_Color COLUMN_HEADER_COLOR = {0xec, 0xed, 0xdc, 0xFF};
+
+// Badges in front of the rows of the compare view
+const SDL_Color DIFF_ADDED_COLOR = {0x4c, 0xa8, 0x5a, 0xFF};
+const SDL_Color DIFF_REMOVED_COLOR = {0xd0, 0x4a, 0x3a, 0xFF};
+const SDL_Color DIFF_CHANGED_COLOR = {0xe0, 0xa0, 0x30, 0xFF};
+const SDL_Color DIFF_PENDING_COLOR = {0xb8, 0xb8, 0xb8, 0xFF};
+
+enum struct Type {
+    DIRECTORY,
+    EXECUTABLE,
+    IMAGE,
+    VIDEO,
+    CODE,
+    OTHER
+};
+
+enum struct SortColumn {
+    TYPE,
+    NAME,
+    MODIFIED,
+    SIZE,
+    PERMISSIONS
+};
+#define NUM_SORT_COLUMNS 5
+
+// How a row of the compare view differs between the two trees, see compare.h
+enum struct DiffKind {
+    NONE,
+    SAME,
+    PENDING,
+    ADDED,
+    REMOVED,
+    CHANGED
+};
+#define RADIX_SORT_THRESHOLD 256
+
+struct CompareNode;
+
+class File {
+    public:
+        std::string name;
+        bool is_dir;
+        std::string extension;
+        std::string permissions;
+        std::string size;
+        std::string modified;
+        Type type;
+        bool is_expanded;
+        bool is_selected;
+        bool has_stat;
+        // Not on disk, its sub_files are kept while collapsed instead of being listed on expansion
+        bool is_virtual;
+        // Set on rows of the compare view, whose contents come from the merged tree
+        DiffKind diff;
+        CompareNode *compare_node;
+        // Path of the archive this row is or lies inside, its members are listed from the archive's index
+        std::string archive;
+        std::vector<File*> sub_files;
+        int depth;
+        std::string path;
+
+        // Sort keys, filled in once when the entry is created
+        uint8_t sort_group;
+        uint64_t size_bytes;
+        int64_t mtime;
+        mode_t mode;
+        std::string collate_name;
+        uint64_t name_key;
+        uint32_t name_rank;
+};
+
+// One rectangle of the treemap view, see treemap.h
+struct TreeNode;
+typedef struct TreemapRect {
+    SDL_Rect rect;
+    TreeNode *node;
+    int depth;
+} TreemapRect;
+
+typedef struct AppData {
+    TTF_Font *font;
+
+    // -- Files -- //
+    std::vector<File*> files;
+
+    // Text is drawn from the shared glyph atlas each frame, see batch.h
+    std::string PathText;
+    std::string PathDisplay;
+    std::string StatusText;
+    std::string HeaderText[NUM_SORT_COLUMNS];
+
+    SDL_Rect Path_rect;
+    SDL_Rect Path_container;
+    SDL_Rect Display_buffer;
+    SDL_Rect Status_rect;
+    SDL_Rect Status_container;
+    SDL_Rect Header_container;
+    SDL_Rect Header_rects[NUM_SORT_COLUMNS];
+
+    SDL_Rect Icon_rect;
+    SDL_Rect Expand_rect;
+
+    // Render Values -
+    int num_files;
+    int page_height;
+    int files_height;
+
+    // Scrolling -
+    int scroll_offset;
+    float scrollbar_ratio;
+    bool scrollbar_enabled;
+    SDL_Rect scrollbar_guide_rect;
+    SDL_Rect scrollbar_handle_rect;
+    int scrollbar_click_xoff;
+    int scrollbar_click_yoff;
+    bool scrollbar_drag;
+
+    // Lazy Metadata -
+    bool lazy_stat;
+    Uint32 stat_event;
+
+    // Session -
+    Uint32 session_event;
+
+    // Treemap -
+    bool treemap_view;
+    Uint32 treemap_event;
+    TreeNode *treemap_root;
+    std::vector<TreemapRect> treemap_rects;
+    SDL_Rect Treemap_area;
+
+    // Archives -
+    Uint32 archive_event;
+
+    // Compare -
+    bool compare_view;
+    Uint32 compare_event;
+
+    // Duplicates -
+    bool dupes_view;
+    Uint32 dupes_event;
+    SortColumn dupes_saved_column;
+    bool dupes_saved_descending;
+
+    // Sorting -
+    SortColumn sort_column;
+    bool sort_descending;
+
+    // File Operations -
+    Uint32 fileops_event;
+    std::vector<std::string> clipboard;
+    bool clipboard_cut;
+    bool delete_pending;
+    bool renaming;
+    std::string rename_source;
+    std::string rename_text;
+
+} AppData;
+
+std::string typeToString(Type t);
+
+std::vector<File*> getItemsInDirectory(std::string dirpath, int depth, bool lazy = false);
+File* createFileEntry(std::string dirpath, std::string name, int depth, bool is_dir);
+File* createLazyFileEntry(std::string dirpath, std::string name, int depth, bool is_dir);
+void applyFileStat(File* file, const struct stat* info);
+File* getFileInfo(std::string path, int depth);
+std::string joinPath(std::string dirpath, std::string name);
+std::string parentPath(std::string path);
+bool isArchiveMember(File* file);
+void freeItemVector(std::vector<File*> *vector_ptr);
+std::string parsePermission(mode_t permission_mode);
+std::string parseSize(size_t byte_size);
+std::string parseTime(int64_t mtime);
+Type parseType(File* file);
+Type parseType(bool is_dir, bool is_executable, std::string extension);
+bool doesContain(std::string str, std::vector<std::string> vec);
+void rankFileNames(std::vector<File*>* files);
+void sortFileVector(std::vector<File*>* files, SortColumn column, bool descending);
+bool fileComesBefore(File* a, File* b, SortColumn column, bool descending);
+
+#endif
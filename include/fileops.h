@@ -0,0 +1,61 @@
+#ifndef FILEOPS_H
+#define FILEOPS_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <SDL.h>
+
+#define FILEOPS_MAX_THREADS 8
+#define FILEOPS_CHUNK_SIZE (8 << 20)
+#define FILEOPS_PROGRESS_INTERVAL_MS 100
+
+enum struct OpKind {
+    COPY,
+    MOVE,
+    DELETE,
+    RENAME
+};
+
+// A queued operation. For COPY and MOVE destination is the target directory,
+// for RENAME it is the new path of the single source, and DELETE ignores it.
+typedef struct FileOp {
+    OpKind kind;
+    std::vector<std::string> sources;
+    std::string destination;
+} FileOp;
+
+// Snapshot of the running operation, for the status bar
+typedef struct FileOpProgress {
+    OpKind kind;
+    uint64_t files_done;
+    uint64_t files_total;
+    uint64_t bytes_done;
+    uint64_t bytes_total;
+    double seconds;
+    int queued;
+} FileOpProgress;
+
+// Outcome of a finished operation. removed and created hold the top-level
+// paths that disappeared or appeared, so the view can be patched in place.
+typedef struct FileOpResult {
+    OpKind kind;
+    std::vector<std::string> removed;
+    std::vector<std::string> created;
+    uint64_t files_done;
+    uint64_t bytes_done;
+    double seconds;
+    bool cancelled;
+    int errors;
+    std::string first_error;
+} FileOpResult;
+
+void initFileOps(Uint32 notify_event);
+void shutdownFileOps();
+void queueFileOp(FileOp op);
+void cancelFileOp();
+bool getFileOpProgress(FileOpProgress* progress);
+bool popFileOpResult(FileOpResult* result);
+std::string opKindToString(OpKind kind);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef IGNORE_H
+#define IGNORE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "explorer.h"
+
+// Read in every directory between a listing and its repository root
+#define IGNORE_FILE_NAME ".gitignore"
+// Used when the user has no ignore list of their own
+#define IGNORE_DEFAULT_RULES ".git/\n"
+// Directories whose ignore state is remembered before the cache starts over
+#define IGNORE_DIRECTORY_CACHE_SIZE 4096
+
+typedef struct IgnoreRules IgnoreRules;
+
+// One rule file that applies to a listing, with the listing's path relative to the file's directory
+typedef struct IgnoreLevel {
+    std::shared_ptr<const IgnoreRules> rules;
+    std::vector<std::string> prefix;
+} IgnoreLevel;
+
+// Everything needed to filter one directory's entries, built once per listing
+typedef struct IgnoreContext {
+    std::vector<IgnoreLevel> levels;
+    bool hide_hidden;
+    bool active;
+} IgnoreContext;
+
+void initIgnore();
+void loadUserIgnoreList(std::string path);
+std::string getIgnoreConfigPath();
+void setIgnoreOptions(bool show_hidden, bool use_rules);
+bool getShowHidden();
+bool getUseIgnoreRules();
+
+IgnoreContext getIgnoreContext(std::string dirpath);
+bool isIgnoredEntry(const IgnoreContext* context, const char* name, bool is_dir);
+
+std::shared_ptr<IgnoreRules> compileIgnoreRules(std::string text);
+
+#endif
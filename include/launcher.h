@@ -0,0 +1,18 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <string>
+#include <vector>
+#include "explorer.h"
+
+// Command used when no handler is configured for a Type
+#define LAUNCHER_DEFAULT_HANDLER "xdg-open %f"
+// Handler processes that can be running at once and still be reaped
+#define LAUNCHER_MAX_CHILDREN 256
+
+void initLauncher();
+void loadLauncherHandlers(std::string config_path);
+std::string getLauncherConfigPath();
+int launchFiles(std::vector<File*> files);
+
+#endif
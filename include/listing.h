@@ -0,0 +1,26 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <string>
+#include "explorer.h"
+
+#define LISTING_THREADS 8
+// Entries listed ahead of the output before the workers wait for it to catch up
+#define LISTING_MAX_BUFFERED 65536
+#define LISTING_OUTPUT_BUFFER (1 << 20)
+
+// What `--list` was asked for on the command line, checked by runListing
+typedef struct ListOptions {
+    std::string path;
+    bool recursive;
+    // tsv, csv or json
+    std::string format;
+    // type, name, modified, size or permissions
+    std::string sort;
+    bool reverse;
+    bool stats;
+} ListOptions;
+
+int runListing(const ListOptions& options);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <SDL.h>
+#include "explorer.h"
+
+#define SESSION_MAGIC "FXSESSN"
+#define SESSION_VERSION 2
+
+// A listed directory and its mtime when the session was saved
+typedef struct SessionDir {
+    std::string path;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} SessionDir;
+
+// Everything needed to draw the previous view. loadSession only decodes the
+// rows on screen, the others stay NULL until finishSession decodes them.
+typedef struct SessionState {
+    std::string path;
+    int scroll_offset;
+    SortColumn sort_column;
+    bool sort_descending;
+    std::vector<File*> rows;
+    std::vector<SessionDir> dirs;
+    // The mapped snapshot, until finishSession or discardSession unmaps it
+    const char* snapshot;
+    size_t snapshot_length;
+} SessionState;
+
+std::string getSessionPath();
+bool saveSession(AppData* data, std::string session_path);
+bool loadSession(std::string session_path, int page_height, SessionState* state);
+bool finishSession(SessionState* state);
+void discardSession(SessionState* state);
+void startSessionRevalidation(std::vector<SessionDir> dirs, Uint32 notify_event);
+void stopSessionRevalidation();
+bool popStaleDirectory(std::string* path);
+
+#endif
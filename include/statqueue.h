@@ -0,0 +1,18 @@
+#ifndef STATQUEUE_H
+#define STATQUEUE_H
+
+#include <vector>
+#include <SDL.h>
+#include "explorer.h"
+
+#define STATQUEUE_THREADS 8
+// How many pages above and below the visible rows are stat'ed ahead of scrolling
+#define STATQUEUE_LOOKAHEAD_PAGES 2
+
+void initStatQueue(Uint32 notify_event);
+void shutdownStatQueue();
+void scheduleStats(std::vector<File*> wanted);
+void forgetFileStat(File* file);
+int collectStatResults();
+
+#endif
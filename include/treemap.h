@@ -0,0 +1,66 @@
+#ifndef TREEMAP_H
+#define TREEMAP_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include <SDL.h>
+#include "explorer.h"
+
+#define TREEMAP_THREADS 8
+// Largest files of each directory that get their own rectangle, the rest are merged per Type
+#define TREEMAP_MAX_FILES 64
+// Directories smaller than this (in pixels, either side) are drawn as a single block
+#define TREEMAP_MIN_NEST_SIZE 12
+// Directories at least this large get a name strip above their contents
+#define TREEMAP_LABEL_MIN_SIZE 40
+#define TREEMAP_LABEL_HEIGHT 16
+// Bounds the work of one layout no matter how large the tree is
+#define TREEMAP_MAX_RECTS 20000
+#define TREEMAP_PROGRESS_INTERVAL_MS 100
+
+const SDL_Color TREEMAP_BORDER_COLOR = {0x40, 0x40, 0x40, 0xFF};
+const SDL_Color TREEMAP_DIRECTORY_COLOR = {0xec, 0xed, 0xdc, 0xFF};
+// Indexed by Type
+const SDL_Color TREEMAP_TYPE_COLORS[] = {
+    {0xd9, 0xdb, 0xb9, 0xFF},
+    {0xe0, 0x7a, 0x5f, 0xFF},
+    {0x81, 0xb2, 0x9a, 0xFF},
+    {0x8e, 0x7d, 0xbe, 0xFF},
+    {0x3d, 0x85, 0xc6, 0xFF},
+    {0xb8, 0xb8, 0xb8, 0xFF}
+};
+
+// A directory, a file, or several small files of one Type merged together.
+// children is written once by the walker before scanned is set and never
+// changes after that; size keeps growing while the walk is running.
+struct TreeNode {
+    std::string name;
+    TreeNode *parent;
+    bool is_dir;
+    Type type;
+    uint32_t merged_files;
+    std::atomic<uint64_t> size;
+    std::atomic<bool> scanned;
+    std::vector<TreeNode*> children;
+};
+
+typedef struct TreemapProgress {
+    uint64_t files;
+    uint64_t dirs;
+    uint64_t bytes;
+    bool done;
+} TreemapProgress;
+
+void startTreemapWalk(std::string path, Uint32 notify_event);
+void stopTreemapWalk();
+TreeNode* getTreemapRoot();
+std::string getTreemapRootPath();
+bool getTreemapProgress(TreemapProgress* progress);
+std::string getTreeNodePath(TreeNode* node);
+
+void layoutTreemap(TreeNode* root, SDL_Rect area, std::vector<TreemapRect>* rects);
+TreeNode* findTreemapDirectory(const std::vector<TreemapRect>& rects, int x, int y);
+
+#endif
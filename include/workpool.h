@@ -0,0 +1,44 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <SDL.h>
+
+// Wakes the main loop for a background job, at most once per interval unless forced
+typedef struct ProgressNotifier {
+    Uint32 event_type;
+    int interval_ms;
+    std::atomic<long long> last_ms;
+} ProgressNotifier;
+
+// Threads working off a shared queue of tasks, where a task may queue more. Tasks
+// queued as deferred only run while no other task is waiting. The pool is done
+// once the queue is empty and no task is running, or when it is stopped.
+typedef struct WorkPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::deque<std::function<void()>> deferred;
+    int busy;
+    bool stopping;
+    // Set when the queue ran dry, not when the pool was stopped
+    std::atomic<bool> done;
+    ProgressNotifier *notifier;
+} WorkPool;
+
+void initProgressNotifier(ProgressNotifier* notifier, Uint32 event_type, int interval_ms);
+void notifyProgress(ProgressNotifier* notifier, bool force);
+
+void startWorkPool(WorkPool* pool, int thread_count, ProgressNotifier* notifier, std::function<void()> first_task);
+void queueWork(WorkPool* pool, std::function<void()> task, bool deferred);
+void waitWorkPool(WorkPool* pool);
+void stopWorkPool(WorkPool* pool);
+
+#endif
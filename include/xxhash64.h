@@ -0,0 +1,21 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// XXH64 from the xxHash specification, with a streaming state for hashing files in chunks
+typedef struct XXH64State {
+    uint64_t acc[4];
+    uint64_t seed;
+    uint64_t total_length;
+    uint8_t buffer[32];
+    uint32_t buffered;
+} XXH64State;
+
+uint64_t xxh64(const void* data, size_t length, uint64_t seed);
+void xxh64Reset(XXH64State* state, uint64_t seed);
+void xxh64Update(XXH64State* state, const void* data, size_t length);
+uint64_t xxh64Digest(const XXH64State* state);
+
+#endif
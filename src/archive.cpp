@@ -0,0 +1,746 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "archive.h"
+
+// Identifies one version of an archive on disk, a rewritten archive is indexed again
+typedef struct ArchiveKey {
+    dev_t dev;
+    ino_t ino;
+    int64_t mtime_sec;
+    long mtime_nsec;
+    off_t size;
+} ArchiveKey;
+
+typedef struct CachedIndex {
+    ArchiveKey key;
+    std::shared_ptr<const ArchiveIndex> index;
+} CachedIndex;
+
+typedef struct IndexJob {
+    ArchiveKey key;
+    std::string path;
+} IndexJob;
+
+// Paths seen so far while an index is built, mapped to their entry
+typedef std::unordered_map<std::string, uint32_t> EntryMap;
+
+static std::vector<std::thread> workers;
+static std::mutex cache_mutex;
+static std::condition_variable jobs_cv;
+static std::deque<IndexJob> jobs;
+static std::vector<ArchiveKey> building;
+// Most recently used first
+static std::list<CachedIndex> cache;
+static std::atomic<bool> stopping(false);
+
+static Uint32 notify_event_type;
+
+static void indexWorker();
+static std::shared_ptr<ArchiveIndex> createIndex();
+static void addEntry(ArchiveIndex* index, EntryMap* map, std::string path, bool is_dir, uint64_t size, int64_t mtime, mode_t mode);
+static uint32_t addParent(ArchiveIndex* index, EntryMap* map, std::string path);
+static bool sameKey(const ArchiveKey& a, const ArchiveKey& b);
+static uint64_t parseTarNumber(const char* field, int length);
+static bool isTarChecksumValid(const unsigned char* header);
+static std::string tarString(const char* field, int length);
+static void parsePaxRecords(const std::string& records, std::string* path, uint64_t* size, int64_t* mtime);
+static uint16_t readLE16(const unsigned char* p);
+static uint32_t readLE32(const unsigned char* p);
+static uint64_t readLE64(const unsigned char* p);
+static int64_t dosTimeToUnix(uint16_t time, uint16_t date);
+static void notify();
+
+
+// ─── CACHE ──────────────────────────────────────────────────────────────────────
+
+
+/** Starts the threads that index archives in the background
+ * @param notify_event SDL event type pushed whenever an index is ready
+ */
+void initArchives(Uint32 notify_event)
+{
+    notify_event_type = notify_event;
+    stopping = false;
+    for(int i = 0; i < ARCHIVE_THREADS; i++)
+    {
+        workers.push_back(std::thread(indexWorker));
+    }
+}
+
+/** Abandons pending indexes, waits for the workers and drops the cache
+ */
+void shutdownArchives()
+{
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    jobs_cv.notify_all();
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    workers.clear();
+    building.clear();
+    cache.clear();
+}
+
+/** @param name File name to check
+ * @return Whether the file is browsed as a directory, judging by its extension
+ */
+bool isArchiveName(std::string name)
+{
+    static const char* const extensions[] = {".tar", ".tar.gz", ".tgz", ".zip"};
+    for(int i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+        size_t length = strlen(extensions[i]);
+        if(name.size() > length && strcasecmp(name.c_str() + name.size() - length, extensions[i]) == 0) return true;
+    }
+    return false;
+}
+
+/** Returns the index of an archive, starting to build it if it isn't cached
+ * Indexes are cached by device, inode and modification time, so an archive that
+ * is opened again or renamed costs nothing while one that changed is read anew.
+ * @param path Path to the archive
+ * @return Index of the archive, or NULL until the notify event says it is ready
+ */
+std::shared_ptr<const ArchiveIndex> getArchiveIndex(std::string path)
+{
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        std::shared_ptr<ArchiveIndex> index = createIndex();
+        index->error = strerror(errno ? errno : EISDIR);
+        return index;
+    }
+
+    ArchiveKey key;
+    key.dev = info.st_dev;
+    key.ino = info.st_ino;
+    key.mtime_sec = info.st_mtim.tv_sec;
+    key.mtime_nsec = info.st_mtim.tv_nsec;
+    key.size = info.st_size;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    for(std::list<CachedIndex>::iterator it = cache.begin(); it != cache.end(); it++)
+    {
+        if(!sameKey(it->key, key)) continue;
+        cache.splice(cache.begin(), cache, it);
+        return cache.front().index;
+    }
+
+    for(int i = 0; i < building.size(); i++)
+    {
+        if(sameKey(building[i], key)) return NULL;
+    }
+    building.push_back(key);
+    IndexJob job;
+    job.key = key;
+    job.path = path;
+    jobs.push_back(job);
+    jobs_cv.notify_one();
+    return NULL;
+}
+
+/** @param index Index to search
+ * @param inner_path Slash separated path inside the archive, "" for its root
+ * @return Entry at that path, or NULL if the archive has none
+ */
+const ArchiveEntry* findArchiveEntry(const ArchiveIndex* index, std::string inner_path)
+{
+    const ArchiveEntry* entry = &index->entries[0];
+    size_t start = 0;
+    while(start < inner_path.size())
+    {
+        size_t end = inner_path.find('/', start);
+        if(end == std::string::npos) end = inner_path.size();
+        std::string component = inner_path.substr(start, end - start);
+        start = end + 1;
+        if(component.empty()) continue;
+
+        const ArchiveEntry* next = NULL;
+        for(int i = 0; i < entry->children.size(); i++)
+        {
+            if(index->entries[entry->children[i]].name != component) continue;
+            next = &index->entries[entry->children[i]];
+            break;
+        }
+        if(next == NULL) return NULL;
+        entry = next;
+    }
+    return entry;
+}
+
+static void indexWorker()
+{
+    while(true)
+    {
+        IndexJob job;
+        {
+            std::unique_lock<std::mutex> lock(cache_mutex);
+            jobs_cv.wait(lock, []{ return stopping || !jobs.empty(); });
+            if(stopping) return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        std::string name = job.path.substr(job.path.find_last_of('/') + 1);
+        size_t length = name.size();
+        bool is_zip = length > 4 && strcasecmp(name.c_str() + length - 4, ".zip") == 0;
+        std::shared_ptr<ArchiveIndex> index = is_zip ? readZipIndex(job.path) : readTarIndex(job.path);
+        if(stopping) return;
+
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            for(int i = 0; i < building.size(); i++)
+            {
+                if(!sameKey(building[i], job.key)) continue;
+                building.erase(building.begin() + i);
+                break;
+            }
+            CachedIndex cached;
+            cached.key = job.key;
+            cached.index = index;
+            cache.push_front(cached);
+            if(cache.size() > ARCHIVE_CACHE_SIZE) cache.pop_back();
+        }
+        notify();
+    }
+}
+
+static bool sameKey(const ArchiveKey& a, const ArchiveKey& b)
+{
+    return a.dev == b.dev && a.ino == b.ino && a.mtime_sec == b.mtime_sec && a.mtime_nsec == b.mtime_nsec && a.size == b.size;
+}
+
+
+// ─── INDEX ──────────────────────────────────────────────────────────────────────
+
+
+static std::shared_ptr<ArchiveIndex> createIndex()
+{
+    std::shared_ptr<ArchiveIndex> index = std::make_shared<ArchiveIndex>();
+    ArchiveEntry root;
+    root.size = 0;
+    root.mtime = 0;
+    root.mode = S_IFDIR | 0755;
+    root.is_dir = true;
+    index->entries.push_back(root);
+    return index;
+}
+
+/** Adds one member of an archive to its index, creating the directories above it
+ * A path that appears twice keeps the metadata of its last appearance, the way
+ * extracting the archive would leave it.
+ * @param index Index being built
+ * @param map Paths already in the index
+ * @param path Path of the member as stored in the archive
+ * @param is_dir Whether the member is a directory
+ * @param size Uncompressed size in bytes
+ * @param mtime Modification time in seconds since the epoch
+ * @param mode File type and permission bits
+ */
+static void addEntry(ArchiveIndex* index, EntryMap* map, std::string path, bool is_dir, uint64_t size, int64_t mtime, mode_t mode)
+{
+    // Normalize "./a//b/" to "a/b", members climbing out with ".." are left out
+    std::string normalized;
+    size_t start = 0;
+    while(start <= path.size())
+    {
+        size_t end = path.find('/', start);
+        if(end == std::string::npos) end = path.size();
+        std::string component = path.substr(start, end - start);
+        start = end + 1;
+        if(component.empty() || component == ".") continue;
+        if(component == "..") return;
+        if(!normalized.empty()) normalized += '/';
+        normalized += component;
+    }
+    if(normalized.empty()) return;
+
+    uint32_t id;
+    EntryMap::iterator found = map->find(normalized);
+    if(found != map->end())
+    {
+        id = found->second;
+    }
+    else
+    {
+        size_t slash = normalized.find_last_of('/');
+        uint32_t parent = slash == std::string::npos ? 0 : addParent(index, map, normalized.substr(0, slash));
+        ArchiveEntry entry;
+        entry.name = slash == std::string::npos ? normalized : normalized.substr(slash + 1);
+        entry.is_dir = false;
+        id = index->entries.size();
+        index->entries.push_back(entry);
+        index->entries[parent].children.push_back(id);
+        (*map)[normalized] = id;
+    }
+
+    ArchiveEntry* entry = &index->entries[id];
+    // A file replacing a directory that already has members would hide them
+    entry->is_dir = is_dir || !entry->children.empty();
+    entry->size = entry->is_dir ? 0 : size;
+    entry->mtime = mtime;
+    entry->mode = entry->is_dir ? (S_IFDIR | (mode & 07777)) : mode;
+}
+
+/** @return Entry of the directory at path, created with default metadata if the archive has none yet
+ */
+static uint32_t addParent(ArchiveIndex* index, EntryMap* map, std::string path)
+{
+    EntryMap::iterator found = map->find(path);
+    if(found != map->end())
+    {
+        ArchiveEntry* entry = &index->entries[found->second];
+        if(!entry->is_dir)
+        {
+            entry->is_dir = true;
+            entry->size = 0;
+            entry->mode = S_IFDIR | (entry->mode & 07777);
+        }
+        return found->second;
+    }
+
+    size_t slash = path.find_last_of('/');
+    uint32_t parent = slash == std::string::npos ? 0 : addParent(index, map, path.substr(0, slash));
+    ArchiveEntry entry;
+    entry.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    entry.size = 0;
+    entry.mtime = 0;
+    entry.mode = S_IFDIR | 0755;
+    entry.is_dir = true;
+    uint32_t id = index->entries.size();
+    index->entries.push_back(entry);
+    index->entries[parent].children.push_back(id);
+    (*map)[path] = id;
+    return id;
+}
+
+
+// ─── TAR ────────────────────────────────────────────────────────────────────────
+
+
+/** Indexes a tar archive, gzip compressed or not, in a single pass over its headers
+ * Member contents are skipped with a seek, which is a real seek on uncompressed
+ * archives and only decompresses without copying on gzip'd ones.
+ * @param path Path to the archive
+ * @return Index of the archive, with error set if it was unreadable or truncated
+ */
+std::shared_ptr<ArchiveIndex> readTarIndex(std::string path)
+{
+    std::shared_ptr<ArchiveIndex> index = createIndex();
+    EntryMap map;
+
+    gzFile archive = gzopen(path.c_str(), "rb");
+    if(archive == NULL)
+    {
+        index->error = strerror(errno ? errno : ENOMEM);
+        return index;
+    }
+    gzbuffer(archive, ARCHIVE_READ_BUFFER);
+
+    // Set by GNU long name and pax headers for the member that follows them
+    std::string next_path;
+    uint64_t next_size = UINT64_MAX;
+    int64_t next_mtime = INT64_MIN;
+    bool have_next_path = false;
+
+    unsigned char header[TAR_BLOCK_SIZE];
+    while(!stopping)
+    {
+        int got = gzread(archive, header, TAR_BLOCK_SIZE);
+        if(got != TAR_BLOCK_SIZE)
+        {
+            // Archives without the closing zero blocks simply end after a member
+            int code;
+            const char* message = gzerror(archive, &code);
+            // zlib puts the path in front of its messages
+            if(code != Z_OK) index->error = strncmp(message, (path + ": ").c_str(), path.size() + 2) == 0 ? message + path.size() + 2 : message;
+            else if(got != 0) index->error = "Unexpected end of archive";
+            break;
+        }
+
+        // The archive ends with zeroed blocks
+        bool all_zero = true;
+        for(int i = 0; i < TAR_BLOCK_SIZE && all_zero; i++) all_zero = header[i] == 0;
+        if(all_zero) break;
+
+        if(!isTarChecksumValid(header))
+        {
+            index->error = index->entries.size() == 1 ? "Not a tar archive" : "Corrupt tar header";
+            break;
+        }
+
+        const char* fields = (const char*) header;
+        char type = fields[156];
+        uint64_t size = parseTarNumber(fields + 124, 12);
+        uint64_t padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+        // GNU long names and pax records are stored as the contents of their own member
+        if(type == 'L' || type == 'x')
+        {
+            if(size > TAR_MAX_METADATA_SIZE)
+            {
+                index->error = "Corrupt tar header";
+                break;
+            }
+            std::string contents(padded, '\0');
+            if(padded > 0 && gzread(archive, &contents[0], padded) != (int) padded)
+            {
+                index->error = "Unexpected end of archive";
+                break;
+            }
+            contents.resize(size);
+            if(type == 'L')
+            {
+                next_path = contents.c_str();
+                have_next_path = true;
+            }
+            else
+            {
+                std::string pax_path;
+                parsePaxRecords(contents, &pax_path, &next_size, &next_mtime);
+                if(!pax_path.empty())
+                {
+                    next_path = pax_path;
+                    have_next_path = true;
+                }
+            }
+            continue;
+        }
+
+        if(type != 'g' && type != 'K' && type != 'V')
+        {
+            std::string name = tarString(fields, 100);
+            // POSIX ustar splits long names into a prefix and a name
+            if(memcmp(fields + 257, "ustar\0", 6) == 0 && fields[345] != '\0')
+            {
+                name = tarString(fields + 345, 155) + "/" + name;
+            }
+            if(have_next_path) name = next_path;
+            if(next_size != UINT64_MAX)
+            {
+                size = next_size;
+                padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+            }
+
+            int64_t mtime = next_mtime != INT64_MIN ? next_mtime : (int64_t) parseTarNumber(fields + 136, 12);
+            mode_t mode = parseTarNumber(fields + 100, 8) & 07777;
+            bool is_dir = type == '5' || (!name.empty() && name[name.size() - 1] == '/');
+            if(is_dir) mode |= S_IFDIR;
+            else if(type == '2') mode |= S_IFLNK;
+            else if(type == '3') mode |= S_IFCHR;
+            else if(type == '4') mode |= S_IFBLK;
+            else if(type == '6') mode |= S_IFIFO;
+            else mode |= S_IFREG;
+            // Links, devices and fifos have no contents of their own
+            uint64_t stored = (type == '1' || type == '2' || type == '3' || type == '4' || type == '6') ? 0 : size;
+            addEntry(index.get(), &map, name, is_dir, stored, mtime, mode);
+
+            have_next_path = false;
+            next_path.clear();
+            next_size = UINT64_MAX;
+            next_mtime = INT64_MIN;
+        }
+
+        if(padded > 0 && gzseek(archive, padded, SEEK_CUR) == -1)
+        {
+            index->error = "Unexpected end of archive";
+            break;
+        }
+    }
+
+    gzclose(archive);
+    return index;
+}
+
+/** Reads a numeric header field, stored either as octal text or as GNU base-256
+ */
+static uint64_t parseTarNumber(const char* field, int length)
+{
+    const unsigned char* bytes = (const unsigned char*) field;
+    uint64_t value = 0;
+    if(bytes[0] & 0x80)
+    {
+        // Negative base-256 values only appear in mtimes before 1970, read as 0
+        if(bytes[0] & 0x40) return 0;
+        value = bytes[0] & 0x3f;
+        for(int i = 1; i < length; i++) value = (value << 8) | bytes[i];
+        return value;
+    }
+
+    int i = 0;
+    while(i < length && (field[i] == ' ' || field[i] == '\0')) i++;
+    for(; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+    {
+        value = (value << 3) | (field[i] - '0');
+    }
+    return value;
+}
+
+/** Checks the header checksum, which some old tars computed over signed bytes
+ */
+static bool isTarChecksumValid(const unsigned char* header)
+{
+    uint64_t expected = parseTarNumber((const char*) header + 148, 8);
+    uint64_t unsigned_sum = 0;
+    int64_t signed_sum = 0;
+    for(int i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        // The checksum field itself counts as spaces
+        unsigned char byte = (i >= 148 && i < 156) ? ' ' : header[i];
+        unsigned_sum += byte;
+        signed_sum += (signed char) byte;
+    }
+    return expected == unsigned_sum || (int64_t) expected == signed_sum;
+}
+
+/** @return A header string field, which isn't NUL terminated when it fills its whole length
+ */
+static std::string tarString(const char* field, int length)
+{
+    return std::string(field, strnlen(field, length));
+}
+
+/** Picks the path, size and mtime out of a pax extended header
+ * Records are "<length> <key>=<value>\n", where length counts the whole record.
+ */
+static void parsePaxRecords(const std::string& records, std::string* path, uint64_t* size, int64_t* mtime)
+{
+    size_t position = 0;
+    while(position < records.size())
+    {
+        size_t space = records.find(' ', position);
+        if(space == std::string::npos) return;
+        size_t length = strtoull(records.c_str() + position, NULL, 10);
+        if(length == 0 || position + length > records.size()) return;
+
+        size_t end = position + length - 1;
+        size_t equals = records.find('=', space);
+        if(equals != std::string::npos && equals < end)
+        {
+            std::string key = records.substr(space + 1, equals - space - 1);
+            std::string value = records.substr(equals + 1, end - equals - 1);
+            if(key == "path") *path = value;
+            else if(key == "size") *size = strtoull(value.c_str(), NULL, 10);
+            else if(key == "mtime") *mtime = strtoll(value.c_str(), NULL, 10);
+        }
+        position += length;
+    }
+}
+
+
+// ─── ZIP ────────────────────────────────────────────────────────────────────────
+
+
+/** Indexes a zip archive from its central directory, without touching member data
+ * The end of central directory record is found in the archive's last 64 KiB and
+ * the whole directory is then read in one go.
+ * @param path Path to the archive
+ * @return Index of the archive, with error set if it was unreadable or malformed
+ */
+std::shared_ptr<ArchiveIndex> readZipIndex(std::string path)
+{
+    std::shared_ptr<ArchiveIndex> index = createIndex();
+    EntryMap map;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if(fd == -1 || fstat(fd, &info) != 0)
+    {
+        index->error = strerror(errno);
+        if(fd != -1) close(fd);
+        return index;
+    }
+
+    // The end record is 22 bytes followed by a comment of up to 65535
+    uint64_t file_size = info.st_size;
+    size_t tail_size = file_size < 22 + 65535 ? file_size : 22 + 65535;
+    std::vector<unsigned char> tail(tail_size);
+    if(tail_size < 22 || pread(fd, &tail[0], tail_size, file_size - tail_size) != (ssize_t) tail_size)
+    {
+        index->error = "Not a zip archive";
+        close(fd);
+        return index;
+    }
+
+    ssize_t end_record = -1;
+    for(ssize_t i = tail_size - 22; i >= 0; i--)
+    {
+        if(readLE32(&tail[i]) == 0x06054b50 && i + 22 + readLE16(&tail[i + 20]) <= tail_size)
+        {
+            end_record = i;
+            break;
+        }
+    }
+    if(end_record == -1)
+    {
+        index->error = "Not a zip archive";
+        close(fd);
+        return index;
+    }
+
+    uint64_t end_offset = file_size - tail_size + end_record;
+    uint64_t count = readLE16(&tail[end_record + 10]);
+    uint64_t directory_size = readLE32(&tail[end_record + 12]);
+    uint64_t directory_offset = readLE32(&tail[end_record + 16]);
+
+    // Zip64 archives point from a locator just before the end record to a larger one
+    unsigned char zip64_end[56];
+    if(end_record >= 20 && readLE32(&tail[end_record - 20]) == 0x07064b50)
+    {
+        uint64_t zip64_offset = readLE64(&tail[end_record - 12]);
+        if(pread(fd, zip64_end, sizeof(zip64_end), zip64_offset) == sizeof(zip64_end) && readLE32(zip64_end) == 0x06064b50)
+        {
+            count = readLE64(zip64_end + 32);
+            directory_size = readLE64(zip64_end + 40);
+            directory_offset = readLE64(zip64_end + 48);
+            end_offset = zip64_offset;
+        }
+    }
+    // Archives with data prepended, like self-extractors, have offsets that are off by its length
+    else if(directory_offset + directory_size != end_offset && directory_size <= end_offset)
+    {
+        directory_offset = end_offset - directory_size;
+    }
+
+    // Checked without adding, a zip64 record can hold offsets that wrap around
+    if(directory_size > file_size || directory_offset > file_size - directory_size)
+    {
+        index->error = "Corrupt zip archive";
+        close(fd);
+        return index;
+    }
+
+    std::vector<unsigned char> directory(directory_size);
+    if(directory_size > 0 && pread(fd, &directory[0], directory_size, directory_offset) != (ssize_t) directory_size)
+    {
+        index->error = strerror(errno ? errno : EIO);
+        close(fd);
+        return index;
+    }
+    close(fd);
+
+    // Every directory header takes at least 46 bytes, a larger count is corrupt
+    if(count > directory_size / 46) count = directory_size / 46;
+    index->entries.reserve(count + 1);
+    map.reserve(count);
+    size_t position = 0;
+    for(uint64_t n = 0; n < count && !stopping; n++)
+    {
+        if(position + 46 > directory_size || readLE32(&directory[position]) != 0x02014b50)
+        {
+            index->error = "Corrupt zip archive";
+            break;
+        }
+
+        const unsigned char* header = &directory[position];
+        uint16_t made_by = readLE16(header + 4);
+        uint64_t size = readLE32(header + 24);
+        uint16_t name_length = readLE16(header + 28);
+        uint16_t extra_length = readLE16(header + 30);
+        uint16_t comment_length = readLE16(header + 32);
+        uint32_t external = readLE32(header + 38);
+        int64_t mtime = dosTimeToUnix(readLE16(header + 12), readLE16(header + 14));
+        if(position + 46 + name_length + extra_length + comment_length > directory_size)
+        {
+            index->error = "Corrupt zip archive";
+            break;
+        }
+        std::string name((const char*) header + 46, name_length);
+
+        const unsigned char* extra = header + 46 + name_length;
+        for(size_t i = 0; i + 4 <= extra_length;)
+        {
+            uint16_t id = readLE16(extra + i);
+            uint16_t length = readLE16(extra + i + 2);
+            if(i + 4 + length > extra_length) break;
+            // Zip64 sizes replace the 32-bit fields that are saturated, uncompressed size first
+            if(id == 0x0001 && size == 0xFFFFFFFF && length >= 8) size = readLE64(extra + i + 4);
+            // Extended timestamp, the central directory only carries the mtime
+            if(id == 0x5455 && length >= 5 && (extra[i + 4] & 1)) mtime = (int32_t) readLE32(extra + i + 5);
+            i += 4 + length;
+        }
+
+        bool is_dir = !name.empty() && name[name.size() - 1] == '/';
+        mode_t mode;
+        // Unix zips keep st_mode in the high half of the external attributes
+        if((made_by >> 8) == 3 && (external >> 16) != 0)
+        {
+            mode = external >> 16;
+            is_dir = is_dir || S_ISDIR(mode);
+            // Some writers leave out the file type bits
+            if((mode & S_IFMT) == 0) mode |= is_dir ? S_IFDIR : S_IFREG;
+        }
+        else
+        {
+            // MS-DOS attributes, 0x10 is a directory and 0x01 read-only
+            is_dir = is_dir || (external & 0x10);
+            mode = is_dir ? (S_IFDIR | 0755) : (S_IFREG | ((external & 0x01) ? 0444 : 0644));
+        }
+        addEntry(index.get(), &map, name, is_dir, size, mtime, mode);
+
+        position += 46 + name_length + extra_length + comment_length;
+    }
+
+    return index;
+}
+
+static uint16_t readLE16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLE32(const unsigned char* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t readLE64(const unsigned char* p)
+{
+    return (uint64_t) readLE32(p) | ((uint64_t) readLE32(p + 4) << 32);
+}
+
+/** Converts the MS-DOS date and time zip stores, which are in local time
+ */
+static int64_t dosTimeToUnix(uint16_t time, uint16_t date)
+{
+    struct tm parts;
+    memset(&parts, 0, sizeof(parts));
+    parts.tm_sec = (time & 0x1f) * 2;
+    parts.tm_min = (time >> 5) & 0x3f;
+    parts.tm_hour = time >> 11;
+    parts.tm_mday = date & 0x1f;
+    parts.tm_mon = ((date >> 5) & 0x0f) - 1;
+    parts.tm_year = (date >> 9) + 80;
+    parts.tm_isdst = -1;
+    return mktime(&parts);
+}
+
+
+// ─── EVENTS ─────────────────────────────────────────────────────────────────────
+
+
+static void notify()
+{
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = notify_event_type;
+    SDL_PushEvent(&event);
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include "assets.h"
+
+typedef struct EmbeddedAsset {
+    const unsigned char *bytes;
+    const uint64_t *size;
+} EmbeddedAsset;
+
+// Indexed by AtlasIcon
+static const EmbeddedAsset icon_assets[NUM_ATLAS_ICONS] = {
+    {asset_directory_icon, &asset_directory_icon_size},
+    {asset_executable_icon, &asset_executable_icon_size},
+    {asset_image_icon, &asset_image_icon_size},
+    {asset_video_icon, &asset_video_icon_size},
+    {asset_code_icon, &asset_code_icon_size},
+    {asset_other_icon, &asset_other_icon_size},
+    {asset_plus_icon, &asset_plus_icon_size},
+    {asset_minus_icon, &asset_minus_icon_size}
+};
+
+
+// ─── ICONS ──────────────────────────────────────────────────────────────────────
+
+
+/** Decodes one embedded icon into an RGBA32 surface ready to be blitted into the atlas
+ * @param icon Which icon to decode
+ * @return The decoded surface, or NULL on failure
+ */
+SDL_Surface* loadEmbeddedIcon(AtlasIcon icon)
+{
+    const EmbeddedAsset *asset = &icon_assets[(int) icon];
+    SDL_Surface *decoded = IMG_Load_RW(SDL_RWFromConstMem(asset->bytes, (int) *asset->size), 1);
+    if(decoded == NULL) {
+        printf("Error: %s\n", SDL_GetError());
+        return NULL;
+    }
+    // Scaled blits need matching formats
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(decoded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(decoded);
+    if(converted == NULL) printf("Error: %s\n", SDL_GetError());
+    return converted;
+}
+
+/** Maps a file Type to its cell in the icon atlas
+ * @param type Type of the file being drawn
+ * @return The matching AtlasIcon
+ */
+AtlasIcon iconForType(Type type)
+{
+    switch(type)
+    {
+        case Type::DIRECTORY:
+            return AtlasIcon::DIRECTORY;
+        case Type::EXECUTABLE:
+            return AtlasIcon::EXECUTABLE;
+        case Type::IMAGE:
+            return AtlasIcon::IMAGE;
+        case Type::VIDEO:
+            return AtlasIcon::VIDEO;
+        case Type::CODE:
+            return AtlasIcon::CODE;
+        default:
+            return AtlasIcon::OTHER;
+    }
+}
+
+
+// ─── FONT ───────────────────────────────────────────────────────────────────────
+
+
+/** Opens the embedded UI font straight from the binary's read-only data
+ * @param point_size Font size in points
+ * @return The opened font, or NULL on failure
+ */
+TTF_Font* openEmbeddedFont(int point_size)
+{
+    SDL_RWops *rw = SDL_RWFromConstMem(asset_font, (int)asset_font_size);
+    TTF_Font *font = TTF_OpenFontRW(rw, 1, point_size);
+    if(font == NULL) printf("Error: %s\n", SDL_GetError());
+    return font;
+}
@@ -0,0 +1,269 @@
+#include <vector>
+#include <stdio.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "batch.h"
+
+// Frames are drawn with SDL_RenderGeometry, added in SDL 2.0.18
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+#error "SDL 2.0.18 or newer is required"
+#endif
+
+typedef struct Glyph {
+    SDL_Rect src;
+    int advance;
+} Glyph;
+
+// One texture holds the icons, the font's glyphs and a block of white pixels
+// that solid rectangles sample, so a whole frame is a single geometry draw.
+static SDL_Texture *atlas = NULL;
+static float atlas_u;
+static float atlas_v;
+static SDL_Rect icon_rects[NUM_ATLAS_ICONS];
+static Glyph glyphs[BATCH_LAST_GLYPH - BATCH_FIRST_GLYPH + 1];
+static SDL_Rect white_rect;
+
+// Reused between frames so steady-state rendering doesn't allocate
+static std::vector<SDL_Vertex> vertices;
+static std::vector<int> indices;
+
+static const SDL_Color WHITE = {255, 255, 255, 255};
+
+static void pushQuad(float x, float y, float w, float h, SDL_Rect src, SDL_Color color);
+static const Glyph* glyphFor(const std::string& text, size_t* i);
+
+
+// ─── ATLAS ──────────────────────────────────────────────────────────────────────
+
+
+/** Builds the shared atlas: the icon strip on top, then shelves of glyphs, then a white block
+ * @param renderer Main-stage renderer
+ * @param font Font the glyphs are rendered from
+ * @return False if the atlas could not be created
+ */
+bool initBatchRenderer(SDL_Renderer *renderer, TTF_Font *font)
+{
+    const int num_glyphs = BATCH_LAST_GLYPH - BATCH_FIRST_GLYPH + 1;
+    std::vector<SDL_Surface*> glyph_surfaces(num_glyphs, (SDL_Surface*)NULL);
+
+    // Glyphs are rendered first so the atlas height is known before it's allocated
+    int x = 0;
+    int y = ATLAS_CELL_SIZE;
+    int shelf = 0;
+    for(int i = 0; i < num_glyphs; i++)
+    {
+        int ch = BATCH_FIRST_GLYPH + i;
+        // Latin-1 code points as UTF-8, so bytes 128-255 render the same characters as before
+        char utf8[3] = {(char)ch, 0, 0};
+        if(ch >= 0x80)
+        {
+            utf8[0] = (char)(0xC0 | (ch >> 6));
+            utf8[1] = (char)(0x80 | (ch & 0x3F));
+        }
+        SDL_Surface *surface = (font == NULL) ? NULL : TTF_RenderUTF8_Blended(font, utf8, WHITE);
+        glyphs[i].src = {0, 0, 0, 0};
+        glyphs[i].advance = 0;
+        if(surface == NULL) continue;
+
+        if(x + surface->w > ATLAS_WIDTH)
+        {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        glyphs[i].src = {x, y, surface->w, surface->h};
+        int minx, maxx, miny, maxy, advance;
+        glyphs[i].advance = (TTF_GlyphMetrics(font, (Uint16)ch, &minx, &maxx, &miny, &maxy, &advance) == 0) ? advance : surface->w;
+        glyph_surfaces[i] = surface;
+        x += surface->w;
+        if(surface->h > shelf) shelf = surface->h;
+    }
+    white_rect = {0, y + shelf, 4, 4};
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, white_rect.y + white_rect.h, 32, SDL_PIXELFORMAT_RGBA32);
+    if(surface == NULL)
+    {
+        printf("Error: %s\n", SDL_GetError());
+        for(int i = 0; i < num_glyphs; i++) SDL_FreeSurface(glyph_surfaces[i]);
+        return false;
+    }
+
+    // BLENDMODE_NONE copies alpha across instead of compositing onto the empty atlas
+    for(int i = 0; i < NUM_ATLAS_ICONS; i++)
+    {
+        icon_rects[i] = {i * ATLAS_CELL_SIZE, 0, ATLAS_CELL_SIZE, ATLAS_CELL_SIZE};
+        SDL_Surface *icon = loadEmbeddedIcon((AtlasIcon) i);
+        if(icon == NULL) continue;
+        SDL_SetSurfaceBlendMode(icon, SDL_BLENDMODE_NONE);
+        SDL_BlitScaled(icon, NULL, surface, &icon_rects[i]);
+        SDL_FreeSurface(icon);
+    }
+    for(int i = 0; i < num_glyphs; i++)
+    {
+        if(glyph_surfaces[i] == NULL) continue;
+        SDL_SetSurfaceBlendMode(glyph_surfaces[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyph_surfaces[i], NULL, surface, &glyphs[i].src);
+        SDL_FreeSurface(glyph_surfaces[i]);
+    }
+    SDL_FillRect(surface, &white_rect, SDL_MapRGBA(surface->format, 255, 255, 255, 255));
+
+    atlas = SDL_CreateTextureFromSurface(renderer, surface);
+    atlas_u = 1.0f / (float) surface->w;
+    atlas_v = 1.0f / (float) surface->h;
+    SDL_FreeSurface(surface);
+    if(atlas == NULL)
+    {
+        printf("Error: %s\n", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+/** Frees the atlas texture
+ */
+void shutdownBatchRenderer()
+{
+    if(atlas != NULL) SDL_DestroyTexture(atlas);
+    atlas = NULL;
+}
+
+
+// ─── BATCH ──────────────────────────────────────────────────────────────────────
+
+
+/** Starts a new frame, dropping the previous frame's geometry but keeping its storage
+ */
+void beginBatch()
+{
+    vertices.clear();
+    indices.clear();
+}
+
+/** Queues a solid rectangle
+ * @param rect Area to fill
+ * @param color Fill color
+ */
+void batchFill(SDL_Rect rect, SDL_Color color)
+{
+    // Sampling the middle of the white block keeps neighbouring glyphs from bleeding in
+    SDL_Rect src = {white_rect.x + 1, white_rect.y + 1, 2, 2};
+    pushQuad((float) rect.x, (float) rect.y, (float) rect.w, (float) rect.h, src, color);
+}
+
+/** Queues an icon from the atlas
+ * @param icon Which icon to draw
+ * @param dst Where to draw it, the icon is scaled to fit
+ */
+void batchIcon(AtlasIcon icon, SDL_Rect dst)
+{
+    pushQuad((float) dst.x, (float) dst.y, (float) dst.w, (float) dst.h, icon_rects[(int) icon], WHITE);
+}
+
+/** Queues a line of text, top-left aligned
+ * @param text UTF-8 text to draw
+ * @param x Left edge
+ * @param y Top edge
+ * @param color Text color
+ * @return Width of the drawn text in pixels
+ */
+int batchText(const std::string& text, int x, int y, SDL_Color color)
+{
+    int pen = x;
+    size_t i = 0;
+    while(i < text.size())
+    {
+        const Glyph *glyph = glyphFor(text, &i);
+        if(glyph->src.w > 0)
+        {
+            pushQuad((float) pen, (float) y, (float) glyph->src.w, (float) glyph->src.h, glyph->src, color);
+        }
+        pen += glyph->advance;
+    }
+    return pen - x;
+}
+
+/** Measures a line of text without drawing it
+ * @param text UTF-8 text to measure
+ * @return Width in pixels
+ */
+int measureText(const std::string& text)
+{
+    int width = 0;
+    size_t i = 0;
+    while(i < text.size()) width += glyphFor(text, &i)->advance;
+    return width;
+}
+
+/** Draws everything queued since beginBatch in one call
+ * @param renderer Main-stage renderer
+ * @return Number of draw calls issued
+ */
+int submitBatch(SDL_Renderer *renderer)
+{
+    if(indices.empty()) return 0;
+    if(SDL_RenderGeometry(renderer, atlas, vertices.data(), (int) vertices.size(), indices.data(), (int) indices.size()) != 0)
+    {
+        printf("Error: %s\n", SDL_GetError());
+    }
+    return 1;
+}
+
+
+// ─── HELPERS ────────────────────────────────────────────────────────────────────
+
+
+/** Appends two triangles covering the given area and atlas rectangle
+ */
+static void pushQuad(float x, float y, float w, float h, SDL_Rect src, SDL_Color color)
+{
+    float u0 = src.x * atlas_u;
+    float v0 = src.y * atlas_v;
+    float u1 = (src.x + src.w) * atlas_u;
+    float v1 = (src.y + src.h) * atlas_v;
+    int base = (int) vertices.size();
+
+    vertices.push_back({{x, y}, color, {u0, v0}});
+    vertices.push_back({{x + w, y}, color, {u1, v0}});
+    vertices.push_back({{x + w, y + h}, color, {u1, v1}});
+    vertices.push_back({{x, y + h}, color, {u0, v1}});
+
+    indices.push_back(base);
+    indices.push_back(base + 1);
+    indices.push_back(base + 2);
+    indices.push_back(base);
+    indices.push_back(base + 2);
+    indices.push_back(base + 3);
+}
+
+/** Decodes the next UTF-8 character of text and returns its glyph
+ * @param text Text being drawn
+ * @param i Byte offset of the character, advanced past it
+ * @return The character's glyph, or the missing glyph if it isn't in the atlas
+ */
+static const Glyph* glyphFor(const std::string& text, size_t* i)
+{
+    unsigned char lead = (unsigned char) text[*i];
+    uint32_t ch = lead;
+    int length = 1;
+    if(lead >= 0xF0) { ch = lead & 0x07; length = 4; }
+    else if(lead >= 0xE0) { ch = lead & 0x0F; length = 3; }
+    else if(lead >= 0xC0) { ch = lead & 0x1F; length = 2; }
+
+    // Malformed sequences fall back to treating the lead byte as Latin-1
+    size_t next = *i + 1;
+    for(int k = 1; k < length; k++, next++)
+    {
+        if(next >= text.size() || ((unsigned char) text[next] & 0xC0) != 0x80)
+        {
+            ch = lead;
+            next = *i + 1;
+            break;
+        }
+        ch = (ch << 6) | ((unsigned char) text[next] & 0x3F);
+    }
+    *i = next;
+
+    if(ch < BATCH_FIRST_GLYPH || ch > BATCH_LAST_GLYPH) ch = BATCH_MISSING_GLYPH;
+    return &glyphs[ch - BATCH_FIRST_GLYPH];
+}
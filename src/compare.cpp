@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "compare.h"
+#include "ignore.h"
+#include "workpool.h"
+
+typedef struct SideEntry {
+    std::string name;
+    struct stat info;
+} SideEntry;
+
+static WorkPool compare_pool;
+static std::atomic<bool> stopping(false);
+
+static CompareNode *root = NULL;
+static std::string root_paths[2];
+static dev_t root_devices[2];
+static bool check_contents = false;
+static std::atomic<uint64_t> entries_seen(0);
+static std::atomic<uint64_t> added_count(0);
+static std::atomic<uint64_t> removed_count(0);
+static std::atomic<uint64_t> changed_count(0);
+static std::atomic<uint64_t> checks_pending(0);
+static std::atomic<uint64_t> bytes_compared(0);
+static ProgressNotifier notifier;
+
+static void scanDirectory(CompareNode* node);
+static void listSide(std::string path, dev_t device, std::vector<SideEntry>* entries);
+static CompareNode* createNode(std::string name, CompareNode* parent, const struct stat* info, DiffKind diff);
+static uint8_t compareEntries(std::string left_path, std::string right_path, const struct stat* left, const struct stat* right);
+static void checkContents(CompareNode* node);
+static ssize_t readChunk(int fd, char* buffer, size_t size);
+static void markChanged(CompareNode* node);
+static void freeTree(CompareNode* node);
+
+
+// ─── WALK ───────────────────────────────────────────────────────────────────────
+
+
+/** Starts comparing two directories, replacing any previous comparison
+ * Both trees are walked together, one directory pair per task, so the whole
+ * comparison costs about one parallel walk. The merged tree can be read while
+ * the walk runs.
+ * @param left The old tree, entries only found here are REMOVED
+ * @param right The new tree, entries only found here are ADDED
+ * @param check_content Compare the bytes of files that match in size, ignoring mtimes
+ * @param notify_event SDL event type pushed as the tree grows and when the comparison ends
+ */
+void startCompare(std::string left, std::string right, bool check_content, Uint32 notify_event)
+{
+    stopCompare();
+
+    struct stat left_info, right_info;
+    if(stat(left.c_str(), &left_info) != 0 || stat(right.c_str(), &right_info) != 0)
+    {
+        printf("Error: %s\n", strerror(errno));
+        return;
+    }
+    if(!S_ISDIR(left_info.st_mode) || !S_ISDIR(right_info.st_mode))
+    {
+        printf("Error: %s\n", strerror(ENOTDIR));
+        return;
+    }
+
+    initProgressNotifier(&notifier, notify_event, COMPARE_PROGRESS_INTERVAL_MS);
+    root_paths[0] = left;
+    root_paths[1] = right;
+    // Like the treemap, other filesystems mounted below either root are not entered
+    root_devices[0] = left_info.st_dev;
+    root_devices[1] = right_info.st_dev;
+    check_contents = check_content;
+    root = createNode("", NULL, &right_info, DiffKind::SAME);
+    entries_seen = 0;
+    added_count = 0;
+    removed_count = 0;
+    changed_count = 0;
+    checks_pending = 0;
+    bytes_compared = 0;
+    stopping = false;
+    startWorkPool(&compare_pool, COMPARE_THREADS, &notifier, []() { scanDirectory(root); });
+}
+
+/** Stops the comparison and frees its tree
+ */
+void stopCompare()
+{
+    stopping = true;
+    stopWorkPool(&compare_pool);
+
+    if(root != NULL) freeTree(root);
+    root = NULL;
+    root_paths[0] = "";
+    root_paths[1] = "";
+}
+
+/** @return Root of the merged tree, or NULL if no comparison was started
+ */
+CompareNode* getCompareRoot()
+{
+    return root;
+}
+
+/** @return One of the compared directories, the right (new) one or the left (old) one
+ */
+std::string getCompareRootPath(bool right)
+{
+    return root_paths[right ? 1 : 0];
+}
+
+/** @return Whether the current comparison checks file contents
+ */
+bool getCompareContent()
+{
+    return check_contents;
+}
+
+/** Reads the comparison's counters
+ * @param progress Filled in with the current totals
+ * @return False if no comparison was started
+ */
+bool getCompareProgress(CompareProgress* progress)
+{
+    if(root == NULL) return false;
+    progress->entries = entries_seen;
+    progress->added = added_count;
+    progress->removed = removed_count;
+    progress->changed = changed_count;
+    progress->checks_pending = checks_pending;
+    progress->bytes_compared = bytes_compared;
+    progress->done = compare_pool.done;
+    return true;
+}
+
+/** Rebuilds the path of a node in one of the trees
+ * @param node Entry of the merged tree
+ * @param right Path in the right tree rather than the left one
+ * @return Its path on disk
+ */
+std::string getCompareNodePath(CompareNode* node, bool right)
+{
+    if(node->parent == NULL) return root_paths[right ? 1 : 0];
+    return joinPath(getCompareNodePath(node->parent, right), node->name);
+}
+
+/** Gets how a node differs, deciding directories found on both sides from what is below them
+ * @param node Entry of the merged tree
+ * @return PENDING for a directory that has no differences so far but isn't fully compared
+ */
+DiffKind getCompareNodeDiff(CompareNode* node)
+{
+    DiffKind diff = node->diff.load(std::memory_order_acquire);
+    if(!node->is_dir || diff != DiffKind::SAME) return diff;
+    if(node->changes > 0) return DiffKind::CHANGED;
+    return compare_pool.done ? DiffKind::SAME : DiffKind::PENDING;
+}
+
+/** Lists why an entry changed, for showing next to its name
+ */
+std::string getDiffReasonText(uint8_t reasons)
+{
+    const char* names[] = {"size", "modified", "mode", "target", "content"};
+    std::string text;
+    for(int i = 0; i < 5; i++)
+    {
+        if(!(reasons & (1 << i))) continue;
+        if(text != "") text += ", ";
+        text += names[i];
+    }
+    return text;
+}
+
+/** Lists a directory in both trees and merges the two listings by name
+ * Runs on the comparison's pool and queues the directories to scan next, then the
+ * files whose contents still need comparing, which wait until the walk is through.
+ * @param node Directory to scan, owned by the calling worker until scanned is set
+ */
+static void scanDirectory(CompareNode* node)
+{
+    DiffKind side_diff = node->diff;
+    std::string left_path = getCompareNodePath(node, false);
+    std::string right_path = getCompareNodePath(node, true);
+    std::vector<SideEntry> left, right;
+    if(side_diff != DiffKind::ADDED) listSide(left_path, root_devices[0], &left);
+    if(side_diff != DiffKind::REMOVED) listSide(right_path, root_devices[1], &right);
+
+    // Below an added or removed directory everything is added or removed too,
+    // only the directory itself counts as a difference of its parents
+    std::vector<CompareNode*> children;
+    std::vector<CompareNode*> checks;
+    size_t li = 0, ri = 0;
+    while(li < left.size() || ri < right.size())
+    {
+        int order = (li == left.size()) ? 1 : (ri == right.size()) ? -1 : strcmp(left[li].name.c_str(), right[ri].name.c_str());
+        if(order < 0 || order > 0)
+        {
+            bool is_left = (order < 0);
+            SideEntry* entry = is_left ? &left[li++] : &right[ri++];
+            DiffKind diff = is_left ? DiffKind::REMOVED : DiffKind::ADDED;
+            children.push_back(createNode(entry->name, node, &entry->info, diff));
+            if(is_left) removed_count++;
+            else added_count++;
+            if(side_diff == DiffKind::SAME) markChanged(node);
+            continue;
+        }
+
+        SideEntry* l = &left[li++];
+        SideEntry* r = &right[ri++];
+        bool left_dir = S_ISDIR(l->info.st_mode);
+        bool right_dir = S_ISDIR(r->info.st_mode);
+        if(left_dir != right_dir)
+        {
+            children.push_back(createNode(l->name, node, &l->info, DiffKind::REMOVED));
+            children.push_back(createNode(r->name, node, &r->info, DiffKind::ADDED));
+            removed_count++;
+            added_count++;
+            markChanged(node);
+            continue;
+        }
+
+        CompareNode* child = createNode(r->name, node, &r->info, DiffKind::SAME);
+        children.push_back(child);
+        if(right_dir) continue;
+
+        uint8_t reasons = compareEntries(joinPath(left_path, l->name), joinPath(right_path, r->name), &l->info, &r->info);
+        if(reasons != 0)
+        {
+            child->diff = DiffKind::CHANGED;
+            child->reasons = reasons;
+            changed_count++;
+            markChanged(node);
+        }
+        else if(check_contents && S_ISREG(r->info.st_mode) && r->info.st_size > 0)
+        {
+            child->diff = DiffKind::PENDING;
+            checks.push_back(child);
+            checks_pending++;
+        }
+    }
+
+    entries_seen += children.size();
+    node->children = children;
+    node->scanned.store(true, std::memory_order_release);
+
+    for(int i = 0; i < children.size(); i++)
+    {
+        CompareNode *child = children[i];
+        if(child->is_dir) queueWork(&compare_pool, [child]() { scanDirectory(child); }, false);
+    }
+    for(int i = 0; i < checks.size(); i++)
+    {
+        CompareNode *check = checks[i];
+        queueWork(&compare_pool, [check]() { checkContents(check); }, true);
+    }
+}
+
+/** Lists one side of a directory pair with the same hidden and ignore filters as the file list
+ * @param path Directory to list
+ * @param device Filesystem of the tree, directories on other ones are left out
+ * @param entries Filled in sorted by name
+ */
+static void listSide(std::string path, dev_t device, std::vector<SideEntry>* entries)
+{
+    DIR *dir = opendir(path.c_str());
+    if(dir == NULL) return;
+    IgnoreContext ignore = getIgnoreContext(path);
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL && !stopping)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        SideEntry side;
+        if(fstatat(dirfd(dir), entry->d_name, &side.info, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if(isIgnoredEntry(&ignore, entry->d_name, S_ISDIR(side.info.st_mode))) continue;
+        if(S_ISDIR(side.info.st_mode) && side.info.st_dev != device) continue;
+        side.name = entry->d_name;
+        entries->push_back(side);
+    }
+    closedir(dir);
+
+    std::sort(entries->begin(), entries->end(), [](const SideEntry& a, const SideEntry& b) { return strcmp(a.name.c_str(), b.name.c_str()) < 0; });
+}
+
+static CompareNode* createNode(std::string name, CompareNode* parent, const struct stat* info, DiffKind diff)
+{
+    CompareNode *node = new CompareNode();
+    node->name = name;
+    node->parent = parent;
+    node->is_dir = S_ISDIR(info->st_mode);
+    node->diff = diff;
+    node->reasons = 0;
+    node->changes = 0;
+    node->size = info->st_size;
+    node->mtime = info->st_mtime;
+    node->mode = info->st_mode;
+    node->scanned = !node->is_dir;
+    return node;
+}
+
+/** Compares the metadata of an entry found in both trees
+ * Modification times are left out when contents are checked, since copying a
+ * tree to where it is deployed usually doesn't keep them.
+ * @return The DIFF_REASON_ flags of every difference, 0 if none was found
+ */
+static uint8_t compareEntries(std::string left_path, std::string right_path, const struct stat* left, const struct stat* right)
+{
+    uint8_t reasons = 0;
+    if(left->st_size != right->st_size) reasons |= DIFF_REASON_SIZE;
+    if(left->st_mode != right->st_mode) reasons |= DIFF_REASON_MODE;
+    if(!check_contents && left->st_mtime != right->st_mtime) reasons |= DIFF_REASON_MTIME;
+
+    if(S_ISLNK(left->st_mode) && S_ISLNK(right->st_mode) && !(reasons & DIFF_REASON_SIZE))
+    {
+        char left_target[PATH_MAX], right_target[PATH_MAX];
+        ssize_t left_length = readlink(left_path.c_str(), left_target, sizeof(left_target));
+        ssize_t right_length = readlink(right_path.c_str(), right_target, sizeof(right_target));
+        if(left_length != right_length || (left_length > 0 && memcmp(left_target, right_target, left_length) != 0))
+        {
+            reasons |= DIFF_REASON_TARGET;
+        }
+    }
+    return reasons;
+}
+
+/** Reads a file from both trees side by side, stopping at the first chunk that differs
+ */
+static void checkContents(CompareNode* node)
+{
+    int left_fd = open(getCompareNodePath(node, false).c_str(), O_RDONLY | O_CLOEXEC);
+    int right_fd = open(getCompareNodePath(node, true).c_str(), O_RDONLY | O_CLOEXEC);
+    bool same = (left_fd >= 0 && right_fd >= 0);
+    if(same)
+    {
+        posix_fadvise(left_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(right_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        static thread_local std::vector<char> left_buffer(COMPARE_READ_SIZE);
+        static thread_local std::vector<char> right_buffer(COMPARE_READ_SIZE);
+        while(!stopping)
+        {
+            ssize_t left_count = readChunk(left_fd, left_buffer.data(), left_buffer.size());
+            ssize_t right_count = readChunk(right_fd, right_buffer.data(), right_buffer.size());
+            if(left_count != right_count || left_count < 0 || memcmp(left_buffer.data(), right_buffer.data(), left_count) != 0)
+            {
+                same = false;
+                break;
+            }
+            if(left_count == 0) break;
+            bytes_compared += 2 * left_count;
+        }
+    }
+    if(left_fd >= 0) close(left_fd);
+    if(right_fd >= 0) close(right_fd);
+
+    if(!same)
+    {
+        node->reasons |= DIFF_REASON_CONTENT;
+        changed_count++;
+        markChanged(node->parent);
+    }
+    node->diff.store(same ? DiffKind::SAME : DiffKind::CHANGED, std::memory_order_release);
+    checks_pending--;
+}
+
+/** Fills a buffer from a file, as read() may return less than asked for before the end
+ * @return Bytes read, short only at the end of the file, or -1 on error
+ */
+static ssize_t readChunk(int fd, char* buffer, size_t size)
+{
+    size_t filled = 0;
+    while(filled < size)
+    {
+        ssize_t count = read(fd, buffer + filled, size - filled);
+        if(count < 0 && errno == EINTR) continue;
+        if(count < 0) return -1;
+        if(count == 0) break;
+        filled += count;
+    }
+    return filled;
+}
+
+/** Counts a difference in a directory and every directory above it
+ */
+static void markChanged(CompareNode* node)
+{
+    for(CompareNode *ancestor = node; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        ancestor->changes++;
+    }
+}
+
+static void freeTree(CompareNode* node)
+{
+    for(int i = 0; i < node->children.size(); i++)
+    {
+        freeTree(node->children[i]);
+    }
+    delete node;
+}
@@ -0,0 +1,454 @@
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "dupes.h"
+#include "explorer.h"
+#include "ignore.h"
+#include "xxhash64.h"
+#include "workpool.h"
+
+typedef struct FileRecord {
+    std::string path;
+    uint64_t size;
+    dev_t dev;
+    ino_t ino;
+} FileRecord;
+
+// One inode that shares its size with another, and what is known about its contents so far
+typedef struct Candidate {
+    uint64_t size;
+    std::vector<std::string> paths;
+    uint64_t partial_hash;
+    uint64_t full_hash;
+    bool fully_hashed;
+    bool readable;
+} Candidate;
+
+typedef std::vector<Candidate*> Bucket;
+
+static std::thread scan_thread;
+static std::atomic<bool> stopping(false);
+static std::string scan_root;
+
+static std::mutex results_mutex;
+static std::deque<DuplicateGroup> results;
+
+static std::atomic<int> stage((int) DupeStage::DONE);
+static std::atomic<uint64_t> files_seen(0);
+static std::atomic<uint64_t> bytes_total(0);
+static std::atomic<uint64_t> bytes_hashed(0);
+static std::atomic<uint64_t> bytes_skipped(0);
+static std::atomic<uint64_t> groups_found(0);
+static std::atomic<uint64_t> bytes_wasted(0);
+
+static ProgressNotifier notifier;
+
+static void scanWorker(std::string path, dev_t device);
+static void walkTree(std::string path, dev_t device, std::vector<FileRecord>* files);
+static void walkDirectory(WorkPool* pool, std::string path, dev_t device, std::mutex* files_mutex, std::vector<FileRecord>* files);
+static void listDirectory(std::string path, dev_t device, std::vector<std::string>* subdirs, std::vector<FileRecord>* files);
+static void parallelFor(size_t count, std::function<void(size_t)> body);
+static void hashPartial(Candidate* candidate);
+static void hashFull(Candidate* candidate);
+static void splitBucket(const Bucket& bucket, bool by_full_hash, std::vector<Bucket>* matches);
+static void emitGroup(const Bucket& bucket);
+
+
+// ─── SCAN ───────────────────────────────────────────────────────────────────────
+
+
+/** Starts looking for duplicate files below a directory, replacing any previous scan
+ * Groups are reported as soon as their last member is hashed, larger sizes first.
+ * @param path Directory to search
+ * @param notify_event SDL event type pushed as groups and progress arrive and when the scan ends
+ */
+void startDuplicateScan(std::string path, Uint32 notify_event)
+{
+    stopDuplicateScan();
+
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        printf("Error: %s\n", strerror(errno ? errno : ENOTDIR));
+        return;
+    }
+
+    initProgressNotifier(&notifier, notify_event, DUPES_PROGRESS_INTERVAL_MS);
+    scan_root = path;
+    stopping = false;
+    stage = (int) DupeStage::LISTING;
+    files_seen = 0;
+    bytes_total = 0;
+    bytes_hashed = 0;
+    bytes_skipped = 0;
+    groups_found = 0;
+    bytes_wasted = 0;
+    // Like the treemap, other filesystems mounted below the root are not entered
+    scan_thread = std::thread(scanWorker, path, info.st_dev);
+}
+
+/** Stops the scan and drops the groups that weren't picked up yet
+ */
+void stopDuplicateScan()
+{
+    stopping = true;
+    if(scan_thread.joinable()) scan_thread.join();
+
+    std::lock_guard<std::mutex> lock(results_mutex);
+    results.clear();
+    scan_root = "";
+}
+
+/** Reads the scan's counters
+ * @param progress Filled in with the current totals
+ * @return False if no scan was started
+ */
+bool getDuplicateProgress(DuplicateProgress* progress)
+{
+    if(scan_root == "") return false;
+    progress->stage = (DupeStage) stage.load();
+    progress->files = files_seen;
+    progress->bytes_total = bytes_total;
+    progress->bytes_hashed = bytes_hashed;
+    progress->bytes_skipped = bytes_skipped;
+    progress->groups = groups_found;
+    progress->bytes_wasted = bytes_wasted;
+    return true;
+}
+
+/** Takes the next group found by the scan
+ * @param group Filled in with the group
+ * @return False if no group is waiting
+ */
+bool popDuplicateGroup(DuplicateGroup* group)
+{
+    std::lock_guard<std::mutex> lock(results_mutex);
+    if(results.empty()) return false;
+    *group = results.front();
+    results.pop_front();
+    return true;
+}
+
+/** Runs the stages in order, each one only looking at what the previous one couldn't rule out
+ * 1. sizes, a file with a unique size has no duplicate and is never opened
+ * 2. paths to the same inode are merged, hard links take no extra space
+ * 3. a hash of the first and last DUPES_BLOCK_SIZE bytes, which settles small files outright
+ * 4. a full streaming hash of what is left, on DUPES_THREADS workers
+ */
+static void scanWorker(std::string path, dev_t device)
+{
+    std::vector<FileRecord> files;
+    walkTree(path, device, &files);
+
+    // Largest first, so the groups worth the most space show up first
+    std::sort(files.begin(), files.end(), [](const FileRecord& a, const FileRecord& b) {
+        if(a.size != b.size) return a.size > b.size;
+        if(a.dev != b.dev) return a.dev < b.dev;
+        return a.ino < b.ino;
+    });
+
+    std::vector<Bucket> buckets;
+    std::vector<Candidate*> candidates;
+    for(size_t start = 0, end; start < files.size(); start = end)
+    {
+        for(end = start + 1; end < files.size() && files[end].size == files[start].size; end++);
+
+        Bucket bucket;
+        for(size_t i = start; i < end; i++)
+        {
+            bool same_inode = (i > start && files[i].dev == files[i - 1].dev && files[i].ino == files[i - 1].ino);
+            if(same_inode)
+            {
+                bucket.back()->paths.push_back(files[i].path);
+                continue;
+            }
+            Candidate *candidate = new Candidate();
+            candidate->size = files[i].size;
+            candidate->paths.push_back(files[i].path);
+            candidate->fully_hashed = false;
+            candidate->readable = true;
+            bucket.push_back(candidate);
+        }
+
+        // Only one copy's contents ever need reading, the other links are skipped
+        for(int i = 0; i < bucket.size(); i++)
+        {
+            bytes_skipped += bucket[i]->size * (bucket[i]->paths.size() - 1);
+        }
+        if(bucket.size() < 2)
+        {
+            bytes_skipped += bucket[0]->size;
+            delete bucket[0];
+            continue;
+        }
+        candidates.insert(candidates.end(), bucket.begin(), bucket.end());
+        buckets.push_back(bucket);
+    }
+    files.clear();
+    files.shrink_to_fit();
+
+    stage = (int) DupeStage::PARTIAL_HASH;
+    notifyProgress(&notifier, true);
+    parallelFor(candidates.size(), [&](size_t i) { hashPartial(candidates[i]); });
+
+    // Matching first and last blocks of a file that fits in them is a match of the whole file
+    std::vector<Bucket> full_buckets;
+    for(int i = 0; i < buckets.size() && !stopping; i++)
+    {
+        std::vector<Bucket> matches;
+        splitBucket(buckets[i], false, &matches);
+        for(int j = 0; j < matches.size(); j++)
+        {
+            if(matches[j][0]->fully_hashed) emitGroup(matches[j]);
+            else full_buckets.push_back(matches[j]);
+        }
+    }
+
+    stage = (int) DupeStage::FULL_HASH;
+    notifyProgress(&notifier, true);
+    std::vector<Candidate*> tasks;
+    std::vector<int> task_bucket;
+    std::vector<int> pending;
+    for(int i = 0; i < full_buckets.size(); i++)
+    {
+        for(int j = 0; j < full_buckets[i].size(); j++)
+        {
+            tasks.push_back(full_buckets[i][j]);
+            task_bucket.push_back(i);
+        }
+        pending.push_back(full_buckets[i].size());
+    }
+    // Whoever hashes the last member of a bucket reports its groups
+    parallelFor(tasks.size(), [&](size_t i) {
+        hashFull(tasks[i]);
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            last = (--pending[task_bucket[i]] == 0);
+        }
+        if(!last) return;
+        std::vector<Bucket> matches;
+        splitBucket(full_buckets[task_bucket[i]], true, &matches);
+        for(int j = 0; j < matches.size(); j++) emitGroup(matches[j]);
+    });
+
+    for(int i = 0; i < candidates.size(); i++) delete candidates[i];
+    stage = (int) DupeStage::DONE;
+    notifyProgress(&notifier, true);
+}
+
+/** Collects every regular file below a directory, listing directories in parallel
+ * @param path Directory to walk
+ * @param device Filesystem the walk stays on
+ * @param files Filled in with the non-empty regular files
+ */
+static void walkTree(std::string path, dev_t device, std::vector<FileRecord>* files)
+{
+    WorkPool pool;
+    std::mutex files_mutex;
+    startWorkPool(&pool, DUPES_THREADS, &notifier, [&]() { walkDirectory(&pool, path, device, &files_mutex, files); });
+    waitWorkPool(&pool);
+}
+
+/** Lists one directory of the walk and queues its subdirectories on the same pool
+ */
+static void walkDirectory(WorkPool* pool, std::string path, dev_t device, std::mutex* files_mutex, std::vector<FileRecord>* files)
+{
+    std::vector<std::string> subdirs;
+    std::vector<FileRecord> found;
+    listDirectory(path, device, &subdirs, &found);
+    {
+        std::lock_guard<std::mutex> lock(*files_mutex);
+        files->insert(files->end(), found.begin(), found.end());
+    }
+    for(int i = 0; i < subdirs.size() && !stopping; i++)
+    {
+        std::string subdir = subdirs[i];
+        queueWork(pool, [=]() { walkDirectory(pool, subdir, device, files_mutex, files); }, false);
+    }
+}
+
+/** Lists one directory with the same hidden and ignore filters as the file list
+ */
+static void listDirectory(std::string path, dev_t device, std::vector<std::string>* subdirs, std::vector<FileRecord>* files)
+{
+    DIR *dir = opendir(path.c_str());
+    if(dir == NULL) return;
+    IgnoreContext ignore = getIgnoreContext(path);
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL && !stopping)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        // Symlinks aren't followed, the file they point to is found under its own path
+        struct stat info;
+        if(fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        bool is_dir = S_ISDIR(info.st_mode);
+        if(isIgnoredEntry(&ignore, entry->d_name, is_dir)) continue;
+
+        if(is_dir)
+        {
+            if(info.st_dev == device) subdirs->push_back(joinPath(path, entry->d_name));
+            continue;
+        }
+        // Empty files are all identical and free, reporting them would only be noise
+        if(!S_ISREG(info.st_mode) || info.st_size == 0) continue;
+
+        FileRecord record;
+        record.path = joinPath(path, entry->d_name);
+        record.size = info.st_size;
+        record.dev = info.st_dev;
+        record.ino = info.st_ino;
+        files->push_back(record);
+        files_seen++;
+        bytes_total += record.size;
+    }
+    closedir(dir);
+}
+
+/** Runs body(0) to body(count - 1) on DUPES_THREADS workers, in roughly that order
+ */
+static void parallelFor(size_t count, std::function<void(size_t)> body)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    int threads = std::min((size_t) DUPES_THREADS, count);
+    for(int i = 0; i < threads; i++)
+    {
+        workers.push_back(std::thread([&]() {
+            for(size_t index = next++; index < count && !stopping; index = next++) body(index);
+        }));
+    }
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+/** Hashes the first and last block of a file, or the whole file if it fits in two blocks
+ */
+static void hashPartial(Candidate* candidate)
+{
+    int fd = open(candidate->paths[0].c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        candidate->readable = false;
+        return;
+    }
+
+    uint8_t buffer[2 * DUPES_BLOCK_SIZE];
+    uint64_t wanted = std::min(candidate->size, (uint64_t) sizeof(buffer));
+    ssize_t head = pread(fd, buffer, std::min(wanted, (uint64_t) DUPES_BLOCK_SIZE), 0);
+    ssize_t tail = 0;
+    if(head >= 0 && wanted > DUPES_BLOCK_SIZE)
+    {
+        tail = pread(fd, buffer + head, wanted - head, candidate->size - (wanted - head));
+    }
+    close(fd);
+
+    // A file that changed size since it was listed can't be compared
+    if(head < 0 || tail < 0 || (uint64_t) (head + tail) != wanted)
+    {
+        candidate->readable = false;
+        return;
+    }
+    bytes_hashed += wanted;
+    candidate->partial_hash = xxh64(buffer, wanted, 0);
+    candidate->fully_hashed = (wanted == candidate->size);
+    if(candidate->fully_hashed) candidate->full_hash = candidate->partial_hash;
+}
+
+/** Hashes a file's whole contents, reading it in DUPES_READ_SIZE chunks
+ */
+static void hashFull(Candidate* candidate)
+{
+    int fd = open(candidate->paths[0].c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        candidate->readable = false;
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    static thread_local std::vector<uint8_t> buffer(DUPES_READ_SIZE);
+    XXH64State state;
+    xxh64Reset(&state, 0);
+    uint64_t total = 0;
+    ssize_t count;
+    while(!stopping && (count = read(fd, buffer.data(), buffer.size())) > 0)
+    {
+        xxh64Update(&state, buffer.data(), count);
+        total += count;
+        bytes_hashed += count;
+    }
+    close(fd);
+
+    if(total != candidate->size)
+    {
+        candidate->readable = false;
+        return;
+    }
+    candidate->full_hash = xxh64Digest(&state);
+    candidate->fully_hashed = true;
+}
+
+/** Splits a bucket by hash, keeping the runs that still have more than one member
+ * Members that were ruled out have the contents that weren't read counted as skipped.
+ * @param bucket Candidates of one size
+ * @param by_full_hash Compare the full hash rather than the partial one
+ * @param matches Appended with the runs of equal hashes
+ */
+static void splitBucket(const Bucket& bucket, bool by_full_hash, std::vector<Bucket>* matches)
+{
+    Bucket sorted;
+    for(int i = 0; i < bucket.size(); i++)
+    {
+        if(bucket[i]->readable) sorted.push_back(bucket[i]);
+    }
+    auto hash = [by_full_hash](const Candidate* candidate) { return by_full_hash ? candidate->full_hash : candidate->partial_hash; };
+    std::sort(sorted.begin(), sorted.end(), [&](const Candidate* a, const Candidate* b) { return hash(a) < hash(b); });
+
+    for(size_t start = 0, end; start < sorted.size(); start = end)
+    {
+        for(end = start + 1; end < sorted.size() && hash(sorted[end]) == hash(sorted[start]); end++);
+        if(end - start > 1)
+        {
+            matches->push_back(Bucket(sorted.begin() + start, sorted.begin() + end));
+        }
+        else if(!sorted[start]->fully_hashed)
+        {
+            bytes_skipped += sorted[start]->size - std::min(sorted[start]->size, (uint64_t) 2 * DUPES_BLOCK_SIZE);
+        }
+    }
+}
+
+/** Hands a set of identical files to the main loop
+ */
+static void emitGroup(const Bucket& bucket)
+{
+    DuplicateGroup group;
+    group.size = bucket[0]->size;
+    for(int i = 0; i < bucket.size(); i++)
+    {
+        group.copies.push_back(bucket[i]->paths);
+    }
+    groups_found++;
+    bytes_wasted += group.size * (bucket.size() - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(results_mutex);
+        results.push_back(group);
+    }
+    notifyProgress(&notifier, false);
+}
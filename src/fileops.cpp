@@ -0,0 +1,841 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <unordered_set>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#include "fileops.h"
+#include "workpool.h"
+
+// One file, directory, symlink or special file to recreate at the destination
+typedef struct CopyItem {
+    std::string source;
+    std::string destination;
+    struct stat info;
+    int root;
+} CopyItem;
+
+typedef struct CopyPlan {
+    std::vector<CopyItem> dirs;
+    std::vector<CopyItem> files;
+    std::vector<CopyItem> links;
+    // FIFOs, sockets and device nodes, recreated rather than read
+    std::vector<CopyItem> nodes;
+    // Roots whose tree could only be read in part, a move never removes these
+    std::unordered_set<int> incomplete;
+} CopyPlan;
+
+// A directory waiting to be removed once everything inside it is gone
+typedef struct DeleteNode {
+    std::string path;
+    DeleteNode* parent;
+    std::atomic<int> pending;
+    int root;
+} DeleteNode;
+
+// Shared state of one parallel delete
+typedef struct DeleteJob {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<DeleteNode*> tasks;
+    std::vector<std::unique_ptr<DeleteNode>> nodes;
+    int outstanding;
+    std::vector<bool> removed;
+} DeleteJob;
+
+static std::thread worker;
+static std::mutex queue_mutex;
+static std::condition_variable queue_cv;
+static std::deque<FileOp> queue;
+static std::deque<FileOpResult> results;
+static bool stopping = false;
+static bool active = false;
+static OpKind active_kind;
+static std::chrono::steady_clock::time_point started;
+
+static std::atomic<bool> cancel_requested(false);
+static std::atomic<uint64_t> files_done(0);
+static std::atomic<uint64_t> files_total(0);
+static std::atomic<uint64_t> bytes_done(0);
+static std::atomic<uint64_t> bytes_total(0);
+
+static std::mutex error_mutex;
+static int error_count;
+static std::string first_error;
+
+static ProgressNotifier notifier;
+
+static void workerLoop();
+static FileOpResult runOp(FileOp op);
+static void runCopy(FileOp op, bool move, FileOpResult* result);
+static void runDelete(std::vector<std::string> paths, FileOpResult* result, std::vector<bool>* removed);
+static void runRename(FileOp op, FileOpResult* result);
+static bool planCopy(std::string source, std::string destination, int root, CopyPlan* plan);
+static bool copyFileData(const CopyItem& item);
+static ssize_t copyChunk(int in_fd, int out_fd, int* method);
+static void deleteWorker(DeleteJob* job);
+static void finishDeleteNode(DeleteJob* job, DeleteNode* node);
+static void runParallel(int thread_count, std::function<void()> task);
+static int threadCount();
+static std::string uniqueDestination(std::string directory, std::string name, bool allow_rename);
+static std::string baseName(std::string path);
+static void recordError(std::string path, int err);
+static double secondsSince(std::chrono::steady_clock::time_point start);
+
+
+// ─── QUEUE ──────────────────────────────────────────────────────────────────────
+
+
+/** Starts the background worker that runs queued operations
+ * @param notify_event SDL event type pushed when progress changes or an operation finishes
+ */
+void initFileOps(Uint32 notify_event)
+{
+    initProgressNotifier(&notifier, notify_event, FILEOPS_PROGRESS_INTERVAL_MS);
+    stopping = false;
+    worker = std::thread(workerLoop);
+}
+
+/** Cancels the running operation, drops the queue and stops the worker
+ */
+void shutdownFileOps()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        queue.clear();
+    }
+    cancel_requested = true;
+    queue_cv.notify_all();
+    if(worker.joinable()) worker.join();
+}
+
+/** Adds an operation to the end of the queue
+ * @param op Operation to run
+ */
+void queueFileOp(FileOp op)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(op);
+    }
+    queue_cv.notify_one();
+    notifyProgress(&notifier, true);
+}
+
+/** Asks the running operation to stop as soon as possible
+ * Files that were only partly copied are removed.
+ */
+void cancelFileOp()
+{
+    cancel_requested = true;
+}
+
+/** Gets the progress of the running operation
+ * @param progress Filled in with the current counters
+ * @return False if no operation is running
+ */
+bool getFileOpProgress(FileOpProgress* progress)
+{
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if(!active) return false;
+    progress->kind = active_kind;
+    progress->files_done = files_done;
+    progress->files_total = files_total;
+    progress->bytes_done = bytes_done;
+    progress->bytes_total = bytes_total;
+    progress->seconds = secondsSince(started);
+    progress->queued = queue.size();
+    return true;
+}
+
+/** Takes the oldest finished operation's result
+ * @param result Filled in with the result
+ * @return False if there are no results waiting
+ */
+bool popFileOpResult(FileOpResult* result)
+{
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if(results.empty()) return false;
+    *result = results.front();
+    results.pop_front();
+    return true;
+}
+
+/** Gets the verb used for an operation in the status bar
+ */
+std::string opKindToString(OpKind kind)
+{
+    switch(kind)
+    {
+        case OpKind::COPY:
+            return "Copying";
+        case OpKind::MOVE:
+            return "Moving";
+        case OpKind::DELETE:
+            return "Deleting";
+        case OpKind::RENAME:
+            return "Renaming";
+    }
+    return "ERR";
+}
+
+static void workerLoop()
+{
+    while(true)
+    {
+        FileOp op;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, []{ return stopping || !queue.empty(); });
+            if(stopping) return;
+            op = queue.front();
+            queue.pop_front();
+            active = true;
+            active_kind = op.kind;
+            started = std::chrono::steady_clock::now();
+            cancel_requested = false;
+            files_done = 0;
+            files_total = 0;
+            bytes_done = 0;
+            bytes_total = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error_count = 0;
+            first_error = "";
+        }
+
+        FileOpResult result = runOp(op);
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            results.push_back(result);
+            active = false;
+        }
+        notifyProgress(&notifier, true);
+    }
+}
+
+static FileOpResult runOp(FileOp op)
+{
+    FileOpResult result;
+    result.kind = op.kind;
+
+    switch(op.kind)
+    {
+        case OpKind::COPY:
+            runCopy(op, false, &result);
+            break;
+        case OpKind::MOVE:
+            runCopy(op, true, &result);
+            break;
+        case OpKind::DELETE:
+        {
+            std::vector<bool> removed;
+            runDelete(op.sources, &result, &removed);
+            for(int i = 0; i < op.sources.size(); i++)
+            {
+                if(removed[i]) result.removed.push_back(op.sources[i]);
+            }
+            break;
+        }
+        case OpKind::RENAME:
+            runRename(op, &result);
+            break;
+    }
+
+    result.files_done = files_done;
+    result.bytes_done = bytes_done;
+    result.seconds = secondsSince(started);
+    result.cancelled = cancel_requested;
+    std::lock_guard<std::mutex> lock(error_mutex);
+    result.errors = error_count;
+    result.first_error = first_error;
+    return result;
+}
+
+
+// ─── COPY & MOVE ────────────────────────────────────────────────────────────────
+
+
+static void runCopy(FileOp op, bool move, FileOpResult* result)
+{
+    CopyPlan plan;
+    std::vector<std::string> roots;
+    std::vector<std::string> destinations;
+    std::vector<std::string> to_delete;
+
+    for(int i = 0; i < op.sources.size() && !cancel_requested; i++)
+    {
+        std::string source = op.sources[i];
+        // Moving into the directory it is already in is a no-op
+        if(move && source.substr(0, source.find_last_of('/')) == op.destination) continue;
+        std::string destination = uniqueDestination(op.destination, baseName(source), !move);
+        if(destination == "")
+        {
+            recordError(op.destination + "/" + baseName(source), EEXIST);
+            continue;
+        }
+        // Refuse to copy a directory into itself
+        if((op.destination + "/").compare(0, source.size() + 1, source + "/") == 0)
+        {
+            recordError(source, EINVAL);
+            continue;
+        }
+
+        // Moves within a filesystem are a single rename
+        if(move)
+        {
+            if(rename(source.c_str(), destination.c_str()) == 0)
+            {
+                files_done++;
+                result->removed.push_back(source);
+                result->created.push_back(destination);
+                continue;
+            }
+            if(errno != EXDEV)
+            {
+                recordError(source, errno);
+                continue;
+            }
+        }
+
+        roots.push_back(source);
+        destinations.push_back(destination);
+        if(!planCopy(source, destination, roots.size() - 1, &plan))
+        {
+            roots.pop_back();
+            destinations.pop_back();
+        }
+    }
+
+    std::vector<bool> failed(roots.size(), false);
+    std::vector<bool> created(roots.size(), false);
+    for(int i = 0; i < roots.size(); i++) failed[i] = plan.incomplete.count(i) > 0;
+    std::mutex failed_mutex;
+
+    // Directories are planned parents-first, create them before their contents
+    for(int i = 0; i < plan.dirs.size() && !cancel_requested; i++)
+    {
+        CopyItem& dir = plan.dirs[i];
+        if(mkdir(dir.destination.c_str(), 0700) != 0)
+        {
+            recordError(dir.destination, errno);
+            failed[dir.root] = true;
+        }
+        else if(dir.destination == destinations[dir.root])
+        {
+            created[dir.root] = true;
+        }
+    }
+
+    // Regular files are copied in parallel, each worker takes the next index
+    std::atomic<size_t> next_file(0);
+    runParallel(threadCount(), [&]() {
+        size_t i;
+        while(!cancel_requested && (i = next_file++) < plan.files.size())
+        {
+            CopyItem& file = plan.files[i];
+            bool ok = copyFileData(file);
+            std::lock_guard<std::mutex> lock(failed_mutex);
+            if(!ok) failed[file.root] = true;
+            else if(file.destination == destinations[file.root]) created[file.root] = true;
+        }
+    });
+
+    for(int i = 0; i < plan.links.size() && !cancel_requested; i++)
+    {
+        CopyItem& link = plan.links[i];
+        std::vector<char> target(link.info.st_size + 1);
+        ssize_t length = readlink(link.source.c_str(), target.data(), target.size());
+        if(length < 0 || symlink(std::string(target.data(), length).c_str(), link.destination.c_str()) != 0)
+        {
+            recordError(link.source, errno);
+            failed[link.root] = true;
+            continue;
+        }
+        files_done++;
+        if(link.destination == destinations[link.root]) created[link.root] = true;
+    }
+
+    for(int i = 0; i < plan.nodes.size() && !cancel_requested; i++)
+    {
+        CopyItem& node = plan.nodes[i];
+        if(mknod(node.destination.c_str(), node.info.st_mode, node.info.st_rdev) != 0)
+        {
+            recordError(node.destination, errno);
+            failed[node.root] = true;
+            continue;
+        }
+        chmod(node.destination.c_str(), node.info.st_mode & 07777);
+        struct timespec times[2] = {node.info.st_atim, node.info.st_mtim};
+        utimensat(AT_FDCWD, node.destination.c_str(), times, 0);
+        files_done++;
+        if(node.destination == destinations[node.root]) created[node.root] = true;
+    }
+
+    // Apply directory modes and times children-first, now that nothing else is written into them
+    for(int i = plan.dirs.size() - 1; i >= 0; i--)
+    {
+        CopyItem& dir = plan.dirs[i];
+        chmod(dir.destination.c_str(), dir.info.st_mode & 07777);
+        struct timespec times[2] = {dir.info.st_atim, dir.info.st_mtim};
+        utimensat(AT_FDCWD, dir.destination.c_str(), times, 0);
+    }
+
+    for(int i = 0; i < roots.size(); i++)
+    {
+        if(created[i]) result->created.push_back(destinations[i]);
+        if(move && created[i] && !failed[i] && !cancel_requested) to_delete.push_back(roots[i]);
+    }
+
+    // A cross-filesystem move finishes by deleting what was copied
+    if(!to_delete.empty())
+    {
+        // Report what was moved, not what the clean-up unlinked as well
+        uint64_t moved = files_done;
+        std::vector<bool> removed;
+        runDelete(to_delete, result, &removed);
+        files_done = moved;
+        for(int i = 0; i < to_delete.size(); i++)
+        {
+            if(removed[i]) result->removed.push_back(to_delete[i]);
+        }
+    }
+}
+
+/** Walks a source tree and records everything that needs to be recreated,
+ * marking the root incomplete when part of the tree below it can't be read
+ * @return False if the source could not be read
+ */
+static bool planCopy(std::string source, std::string destination, int root, CopyPlan* plan)
+{
+    CopyItem item;
+    item.source = source;
+    item.destination = destination;
+    item.root = root;
+    if(lstat(source.c_str(), &item.info) != 0)
+    {
+        recordError(source, errno);
+        return false;
+    }
+
+    if(S_ISLNK(item.info.st_mode))
+    {
+        plan->links.push_back(item);
+        files_total++;
+        return true;
+    }
+    // Opening a FIFO would block the worker and a device would be read for its contents
+    if(!S_ISDIR(item.info.st_mode) && !S_ISREG(item.info.st_mode))
+    {
+        plan->nodes.push_back(item);
+        files_total++;
+        return true;
+    }
+    if(S_ISREG(item.info.st_mode))
+    {
+        plan->files.push_back(item);
+        files_total++;
+        bytes_total += item.info.st_size;
+        return true;
+    }
+
+    plan->dirs.push_back(item);
+    DIR* dir = opendir(source.c_str());
+    if(dir == NULL)
+    {
+        recordError(source, errno);
+        plan->incomplete.insert(root);
+        return true;
+    }
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL && !cancel_requested)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if(!planCopy(source + "/" + entry->d_name, destination + "/" + entry->d_name, root, plan))
+        {
+            plan->incomplete.insert(root);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+/** Copies one regular file, preferring a reflink and then in-kernel copies
+ * @return True if the whole file was copied
+ */
+static bool copyFileData(const CopyItem& item)
+{
+    int in_fd = open(item.source.c_str(), O_RDONLY | O_CLOEXEC);
+    if(in_fd < 0)
+    {
+        recordError(item.source, errno);
+        return false;
+    }
+    int out_fd = open(item.destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, (item.info.st_mode & 07777) | 0200);
+    if(out_fd < 0)
+    {
+        recordError(item.destination, errno);
+        close(in_fd);
+        return false;
+    }
+
+    bool ok = true;
+    // Filesystems with shared extents (btrfs, xfs) can clone without copying any data
+    if(ioctl(out_fd, FICLONE, in_fd) == 0)
+    {
+        bytes_done += item.info.st_size;
+    }
+    else
+    {
+        int method = 0;
+        ssize_t copied;
+        while((copied = copyChunk(in_fd, out_fd, &method)) > 0)
+        {
+            bytes_done += copied;
+            notifyProgress(&notifier, false);
+            if(cancel_requested)
+            {
+                ok = false;
+                break;
+            }
+        }
+        if(copied < 0)
+        {
+            recordError(item.destination, errno);
+            ok = false;
+        }
+    }
+
+    if(ok)
+    {
+        fchmod(out_fd, item.info.st_mode & 07777);
+        struct timespec times[2] = {item.info.st_atim, item.info.st_mtim};
+        futimens(out_fd, times);
+    }
+    close(in_fd);
+    if(close(out_fd) != 0 && ok)
+    {
+        recordError(item.destination, errno);
+        ok = false;
+    }
+
+    // Don't leave half-written files behind
+    if(!ok) unlink(item.destination.c_str());
+    else files_done++;
+    return ok;
+}
+
+/** Copies the next chunk between two file offsets
+ * Falls back from copy_file_range to sendfile to read/write when the kernel
+ * or filesystem doesn't support the faster call.
+ * @param method 0 = copy_file_range, 1 = sendfile, 2 = read/write. Advanced on fallback.
+ * @return Bytes copied, 0 at end of file, -1 on error
+ */
+static ssize_t copyChunk(int in_fd, int out_fd, int* method)
+{
+    while(true)
+    {
+        ssize_t copied;
+        if(*method == 0)
+        {
+            copied = copy_file_range(in_fd, NULL, out_fd, NULL, FILEOPS_CHUNK_SIZE, 0);
+        }
+        else if(*method == 1)
+        {
+            copied = sendfile(out_fd, in_fd, NULL, FILEOPS_CHUNK_SIZE);
+        }
+        else
+        {
+            static thread_local std::vector<char> buffer(1 << 20);
+            copied = read(in_fd, buffer.data(), buffer.size());
+            ssize_t written = 0;
+            while(copied > 0 && written < copied)
+            {
+                ssize_t n = write(out_fd, buffer.data() + written, copied - written);
+                if(n < 0)
+                {
+                    if(errno == EINTR) continue;
+                    return -1;
+                }
+                written += n;
+            }
+        }
+
+        if(copied >= 0) return copied;
+        if(errno == EINTR) continue;
+        if(*method < 2 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF))
+        {
+            (*method)++;
+            continue;
+        }
+        return -1;
+    }
+}
+
+
+// ─── DELETE ─────────────────────────────────────────────────────────────────────
+
+
+/** Removes files and directory trees
+ * Directories are listed in parallel; each one is removed by whichever worker
+ * unlinks its last entry, so no worker waits on another.
+ * @param paths Top-level paths to remove
+ * @param removed Set to whether each path is gone afterwards
+ */
+static void runDelete(std::vector<std::string> paths, FileOpResult* result, std::vector<bool>* removed)
+{
+    DeleteJob job;
+    job.outstanding = 0;
+    job.removed.assign(paths.size(), false);
+
+    for(int i = 0; i < paths.size(); i++)
+    {
+        struct stat info;
+        if(lstat(paths[i].c_str(), &info) != 0)
+        {
+            recordError(paths[i], errno);
+            continue;
+        }
+        if(!S_ISDIR(info.st_mode))
+        {
+            files_total++;
+            if(unlink(paths[i].c_str()) == 0)
+            {
+                files_done++;
+                job.removed[i] = true;
+            }
+            else
+            {
+                recordError(paths[i], errno);
+            }
+            continue;
+        }
+
+        DeleteNode* node = new DeleteNode();
+        node->path = paths[i];
+        node->parent = NULL;
+        node->pending = 1;
+        node->root = i;
+        job.nodes.push_back(std::unique_ptr<DeleteNode>(node));
+        job.tasks.push_back(node);
+        job.outstanding++;
+    }
+
+    if(job.outstanding > 0)
+    {
+        runParallel(threadCount(), [&]() { deleteWorker(&job); });
+    }
+    *removed = job.removed;
+}
+
+static void deleteWorker(DeleteJob* job)
+{
+    while(true)
+    {
+        DeleteNode* node;
+        {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->cv.wait(lock, [&]{ return !job->tasks.empty() || job->outstanding == 0 || cancel_requested; });
+            if(job->tasks.empty() || cancel_requested) return;
+            node = job->tasks.front();
+            job->tasks.pop_front();
+        }
+
+        int dir_fd = open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        DIR* dir = (dir_fd >= 0) ? fdopendir(dir_fd) : NULL;
+        if(dir == NULL)
+        {
+            recordError(node->path, errno);
+            if(dir_fd >= 0) close(dir_fd);
+        }
+        else
+        {
+            struct dirent *entry;
+            while((entry = readdir(dir)) != NULL && !cancel_requested)
+            {
+                if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+                bool is_dir = (entry->d_type == DT_DIR);
+                if(entry->d_type == DT_UNKNOWN)
+                {
+                    struct stat info;
+                    is_dir = (fstatat(dir_fd, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(info.st_mode));
+                }
+
+                if(is_dir)
+                {
+                    DeleteNode* child = new DeleteNode();
+                    child->path = node->path + "/" + entry->d_name;
+                    child->parent = node;
+                    child->pending = 1;
+                    child->root = node->root;
+                    node->pending++;
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->nodes.push_back(std::unique_ptr<DeleteNode>(child));
+                    job->tasks.push_back(child);
+                    job->outstanding++;
+                    job->cv.notify_one();
+                }
+                else
+                {
+                    files_total++;
+                    if(unlinkat(dir_fd, entry->d_name, 0) == 0) files_done++;
+                    else recordError(node->path + "/" + entry->d_name, errno);
+                    notifyProgress(&notifier, false);
+                }
+            }
+            closedir(dir);
+        }
+
+        finishDeleteNode(job, node);
+
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->outstanding--;
+        if(job->outstanding == 0 || cancel_requested) job->cv.notify_all();
+    }
+}
+
+/** Drops one pending reference on a directory, removing it once it is empty
+ */
+static void finishDeleteNode(DeleteJob* job, DeleteNode* node)
+{
+    while(node != NULL && --node->pending == 0)
+    {
+        if(cancel_requested) return;
+        if(unlinkat(AT_FDCWD, node->path.c_str(), AT_REMOVEDIR) != 0)
+        {
+            recordError(node->path, errno);
+            return;
+        }
+        if(node->parent == NULL)
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->removed[node->root] = true;
+        }
+        node = node->parent;
+    }
+}
+
+
+// ─── RENAME ─────────────────────────────────────────────────────────────────────
+
+
+static void runRename(FileOp op, FileOpResult* result)
+{
+    if(op.sources.size() != 1) return;
+    std::string source = op.sources[0];
+    files_total = 1;
+
+    // rename() silently replaces files, never overwrite an existing entry
+    struct stat info;
+    if(lstat(op.destination.c_str(), &info) == 0)
+    {
+        recordError(op.destination, EEXIST);
+        return;
+    }
+    if(rename(source.c_str(), op.destination.c_str()) != 0)
+    {
+        recordError(source, errno);
+        return;
+    }
+    files_done = 1;
+    result->removed.push_back(source);
+    result->created.push_back(op.destination);
+}
+
+
+// ─── HELPERS ────────────────────────────────────────────────────────────────────
+
+
+/** Runs the same task on several threads and waits for all of them
+ */
+static void runParallel(int thread_count, std::function<void()> task)
+{
+    std::vector<std::thread> threads;
+    for(int i = 1; i < thread_count; i++)
+    {
+        threads.push_back(std::thread(task));
+    }
+    task();
+    for(int i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+}
+
+static int threadCount()
+{
+    int count = std::thread::hardware_concurrency();
+    if(count < 1) count = 1;
+    if(count > FILEOPS_MAX_THREADS) count = FILEOPS_MAX_THREADS;
+    return count;
+}
+
+/** Picks the destination path for an item copied into a directory
+ * @param allow_rename If set, a taken name becomes "name (copy)", "name (copy 2)", ...
+ * @return The path, or "" if the name is taken and renaming isn't allowed
+ */
+static std::string uniqueDestination(std::string directory, std::string name, bool allow_rename)
+{
+    std::string prefix = (directory.size() > 0 && directory.back() == '/') ? directory : directory + "/";
+    std::string candidate = prefix + name;
+    struct stat info;
+    if(lstat(candidate.c_str(), &info) != 0) return candidate;
+    if(!allow_rename) return "";
+
+    // Keep the extension at the end: "photo (copy).png"
+    std::string stem = name;
+    std::string extension = "";
+    size_t dot_pos = name.find_last_of('.');
+    if(dot_pos != std::string::npos && dot_pos > 0)
+    {
+        stem = name.substr(0, dot_pos);
+        extension = name.substr(dot_pos);
+    }
+    for(int i = 1; ; i++)
+    {
+        std::string suffix = (i == 1) ? " (copy)" : " (copy " + std::to_string(i) + ")";
+        candidate = prefix + stem + suffix + extension;
+        if(lstat(candidate.c_str(), &info) != 0) return candidate;
+    }
+}
+
+static std::string baseName(std::string path)
+{
+    while(path.size() > 1 && path.back() == '/') path.pop_back();
+    size_t slash = path.find_last_of('/');
+    if(slash == std::string::npos) return path;
+    return path.substr(slash + 1);
+}
+
+static void recordError(std::string path, int err)
+{
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if(error_count == 0)
+    {
+        first_error = path + ": " + strerror(err);
+    }
+    error_count++;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
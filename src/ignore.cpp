@@ -0,0 +1,525 @@
+#include <fstream>
+#include <sstream>
+#include <bitset>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "ignore.h"
+
+enum GlobTokenKind : uint8_t {
+    GLOB_LITERAL,
+    GLOB_ANY_CHAR,
+    GLOB_ANY_RUN,
+    GLOB_CLASS
+};
+
+typedef struct GlobToken {
+    uint8_t kind;
+    unsigned char ch;
+    uint16_t set;
+} GlobToken;
+
+// One '/'-separated part of a pattern; plain names skip the token matcher entirely
+typedef struct GlobSegment {
+    bool any_depth;
+    bool literal;
+    std::string text;
+    std::vector<GlobToken> tokens;
+} GlobSegment;
+
+typedef struct IgnoreRule {
+    std::vector<GlobSegment> segments;
+    bool negate;
+    bool dir_only;
+    bool anchored;
+    bool fixed_depth;
+} IgnoreRule;
+
+struct IgnoreRules {
+    std::vector<IgnoreRule> rules;
+    std::vector<std::bitset<256>> classes;
+};
+
+typedef struct CachedRules {
+    std::shared_ptr<const IgnoreRules> rules;
+    struct timespec mtime;
+    off_t size;
+} CachedRules;
+
+// What a directory contributes to the listings below it
+typedef struct CachedDirectory {
+    std::shared_ptr<const IgnoreRules> rules;
+    std::shared_ptr<const IgnoreRules> exclude;
+    bool repository_root;
+} CachedDirectory;
+
+static std::mutex cache_mutex;
+static std::unordered_map<std::string, CachedRules> rules_cache;
+static std::unordered_map<std::string, CachedDirectory> directory_cache;
+
+static std::shared_ptr<const IgnoreRules> user_rules;
+static std::atomic<bool> show_hidden(true);
+static std::atomic<bool> use_rules(true);
+
+static std::shared_ptr<const IgnoreRules> getCachedRules(std::string path);
+static CachedDirectory getCachedDirectory(std::string dirpath, bool refresh);
+static bool isRepositoryRoot(std::string dirpath);
+static bool compileRule(std::string line, IgnoreRules* set, IgnoreRule* rule);
+static GlobSegment compileSegment(std::string text, IgnoreRules* set);
+static bool matchSegment(const IgnoreRules* set, const GlobSegment* segment, const char* text, size_t length);
+static bool matchPath(const IgnoreRules* set, const IgnoreRule* rule, size_t si, const IgnoreLevel* level, const char* name, size_t pi);
+static bool ruleMatches(const IgnoreRules* set, const IgnoreRule* rule, const IgnoreLevel* level, const char* name, size_t length, bool is_dir);
+
+
+// ─── SETUP ──────────────────────────────────────────────────────────────────────
+
+
+/** Loads the user's ignore list
+ */
+void initIgnore()
+{
+    loadUserIgnoreList(getIgnoreConfigPath());
+}
+
+/** Compiles the user-level ignore list, falling back to IGNORE_DEFAULT_RULES when there is none
+ * Its patterns apply everywhere; ones containing a '/' match against the absolute path.
+ * @param path Path of the ignore list
+ */
+void loadUserIgnoreList(std::string path)
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+    {
+        user_rules = compileIgnoreRules(IGNORE_DEFAULT_RULES);
+        return;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    user_rules = compileIgnoreRules(text.str());
+}
+
+/** Finds the user's ignore list, following the XDG base directory spec
+ * @return Path of the ignore list, or an empty string if HOME is unset
+ */
+std::string getIgnoreConfigPath()
+{
+    char *config_home = getenv("XDG_CONFIG_HOME");
+    if(config_home != NULL && config_home[0] != '\0')
+    {
+        return std::string(config_home) + "/fileexplorer/ignore";
+    }
+    char *home = getenv("HOME");
+    if(home == NULL) return "";
+    return std::string(home) + "/.config/fileexplorer/ignore";
+}
+
+/** Changes what later listings leave out
+ * @param hidden Whether names starting with '.' are listed
+ * @param rules Whether ignore files and the user list are applied
+ */
+void setIgnoreOptions(bool hidden, bool rules)
+{
+    show_hidden = hidden;
+    use_rules = rules;
+}
+
+bool getShowHidden()
+{
+    return show_hidden;
+}
+
+bool getUseIgnoreRules()
+{
+    return use_rules;
+}
+
+
+// ─── CONTEXT ────────────────────────────────────────────────────────────────────
+
+
+/** Collects the rules that apply to one directory's entries
+ * Ignore files are read from the directory up to its repository root, deepest first,
+ * so closer files override outer ones. Outside a repository only the user list applies.
+ * Only the listed directory is checked on disk, its ancestors come from the cache
+ * and are checked again when they are listed themselves.
+ * @param dirpath Directory about to be listed
+ * @return The context to pass to isIgnoredEntry for each entry
+ */
+IgnoreContext getIgnoreContext(std::string dirpath)
+{
+    IgnoreContext context;
+    context.hide_hidden = !show_hidden;
+
+    if(use_rules)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream(dirpath);
+        std::string part;
+        while(std::getline(stream, part, '/'))
+        {
+            if(part != "") parts.push_back(part);
+        }
+
+        std::vector<IgnoreLevel> repository_levels;
+        bool in_repository = false;
+        for(int depth = (int) parts.size(); depth >= 0 && !in_repository; depth--)
+        {
+            std::string dir = "";
+            for(int i = 0; i < depth; i++) dir += "/" + parts[i];
+            if(dir == "") dir = "/";
+
+            CachedDirectory cached = getCachedDirectory(dir, depth == (int) parts.size());
+            IgnoreLevel level;
+            level.prefix.assign(parts.begin() + depth, parts.end());
+            level.rules = cached.rules;
+            if(level.rules != NULL) repository_levels.push_back(level);
+
+            if(cached.repository_root)
+            {
+                // The repository's private excludes rank below every ignore file in it
+                level.rules = cached.exclude;
+                if(level.rules != NULL) repository_levels.push_back(level);
+                in_repository = true;
+            }
+        }
+        if(in_repository) context.levels = repository_levels;
+
+        if(user_rules != NULL && !user_rules->rules.empty())
+        {
+            IgnoreLevel level;
+            level.rules = user_rules;
+            level.prefix = parts;
+            context.levels.push_back(level);
+        }
+    }
+
+    context.active = context.hide_hidden || !context.levels.empty();
+    return context;
+}
+
+/** Decides whether a directory entry is left out of a listing
+ * Called straight on readdir's d_name, so it neither stats nor allocates.
+ * @param context Rules for the directory being listed
+ * @param name Entry name
+ * @param is_dir Whether the entry is a directory, for patterns ending in '/'
+ * @return True if the entry should be skipped
+ */
+bool isIgnoredEntry(const IgnoreContext* context, const char* name, bool is_dir)
+{
+    if(!context->active) return false;
+    if(strcmp(name, "..") == 0) return false;
+    if(context->hide_hidden && name[0] == '.') return true;
+
+    size_t length = strlen(name);
+    for(int i = 0; i < context->levels.size(); i++)
+    {
+        const IgnoreLevel *level = &context->levels[i];
+        const IgnoreRules *set = level->rules.get();
+        // The last matching rule in a file wins
+        for(int r = (int) set->rules.size() - 1; r >= 0; r--)
+        {
+            const IgnoreRule *rule = &set->rules[r];
+            if(ruleMatches(set, rule, level, name, length, is_dir)) return !rule->negate;
+        }
+    }
+    return false;
+}
+
+
+// ─── CACHE ──────────────────────────────────────────────────────────────────────
+
+
+/** Returns the compiled rules of one ignore file, parsing it only when it changed
+ * @param path Path of the ignore file
+ * @return Its rules, or NULL if the file doesn't exist or holds no rules
+ */
+static std::shared_ptr<const IgnoreRules> getCachedRules(std::string path)
+{
+    struct stat info;
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        rules_cache.erase(path);
+        return NULL;
+    }
+
+    auto cached = rules_cache.find(path);
+    if(cached != rules_cache.end() && cached->second.size == info.st_size &&
+       cached->second.mtime.tv_sec == info.st_mtim.tv_sec && cached->second.mtime.tv_nsec == info.st_mtim.tv_nsec)
+    {
+        return cached->second.rules;
+    }
+
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::shared_ptr<IgnoreRules> rules = compileIgnoreRules(text.str());
+
+    CachedRules entry;
+    entry.rules = rules->rules.empty() ? NULL : rules;
+    entry.mtime = info.st_mtim;
+    entry.size = info.st_size;
+    rules_cache[path] = entry;
+    return entry.rules;
+}
+
+/** Returns the ignore files and repository status of one directory
+ * @param dirpath Directory between a listing and its repository root
+ * @param refresh Check the directory on disk even if it is cached
+ * @return Its cached or freshly read state
+ */
+static CachedDirectory getCachedDirectory(std::string dirpath, bool refresh)
+{
+    if(!refresh)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto cached = directory_cache.find(dirpath);
+        if(cached != directory_cache.end()) return cached->second;
+    }
+
+    CachedDirectory entry;
+    entry.rules = getCachedRules(joinPath(dirpath, IGNORE_FILE_NAME));
+    entry.repository_root = isRepositoryRoot(dirpath);
+    if(entry.repository_root) entry.exclude = getCachedRules(joinPath(dirpath, ".git/info/exclude"));
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if(directory_cache.size() >= IGNORE_DIRECTORY_CACHE_SIZE) directory_cache.clear();
+    directory_cache[dirpath] = entry;
+    return entry;
+}
+
+/** Checks for a .git entry, a directory in a normal clone and a file in worktrees and submodules
+ */
+static bool isRepositoryRoot(std::string dirpath)
+{
+    struct stat info;
+    return stat(joinPath(dirpath, ".git").c_str(), &info) == 0;
+}
+
+
+// ─── COMPILER ───────────────────────────────────────────────────────────────────
+
+
+/** Compiles the contents of a .gitignore-style file
+ * @param text File contents, one pattern per line
+ * @return The compiled rules, in file order
+ */
+std::shared_ptr<IgnoreRules> compileIgnoreRules(std::string text)
+{
+    std::shared_ptr<IgnoreRules> set = std::make_shared<IgnoreRules>();
+    std::stringstream stream(text);
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        IgnoreRule rule;
+        if(compileRule(line, set.get(), &rule)) set->rules.push_back(rule);
+    }
+    return set;
+}
+
+/** Compiles one line of an ignore file
+ * @param line Raw line
+ * @param set Rule set that owns any character classes
+ * @param rule Filled in with the compiled rule
+ * @return False for blank lines and comments
+ */
+static bool compileRule(std::string line, IgnoreRules* set, IgnoreRule* rule)
+{
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+    if(line.empty() || line[0] == '#') return false;
+
+    // Trailing spaces are dropped unless escaped with a backslash
+    size_t end = line.size();
+    while(end > 0 && line[end - 1] == ' ' && !(end > 1 && line[end - 2] == '\\')) end--;
+    line.resize(end);
+
+    rule->negate = (line[0] == '!');
+    if(rule->negate) line.erase(0, 1);
+
+    rule->dir_only = (!line.empty() && line.back() == '/');
+    if(rule->dir_only) line.pop_back();
+    if(line.empty()) return false;
+
+    // A slash anywhere but the end ties the pattern to the ignore file's directory
+    rule->anchored = (line.find('/') != std::string::npos);
+    if(line[0] == '/') line.erase(0, 1);
+
+    rule->fixed_depth = true;
+    std::stringstream stream(line);
+    std::string part;
+    while(std::getline(stream, part, '/'))
+    {
+        if(part.empty()) continue;
+        GlobSegment segment = compileSegment(part, set);
+        if(segment.any_depth) rule->fixed_depth = false;
+        rule->segments.push_back(segment);
+    }
+    return !rule->segments.empty();
+}
+
+/** Compiles one path segment of a pattern into tokens
+ * @param text Segment text, without slashes
+ * @param set Rule set that owns any character classes
+ * @return The compiled segment
+ */
+static GlobSegment compileSegment(std::string text, IgnoreRules* set)
+{
+    GlobSegment segment;
+    segment.any_depth = (text == "**");
+    segment.literal = true;
+    if(segment.any_depth) return segment;
+
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        GlobToken token = {GLOB_LITERAL, (unsigned char) text[i], 0};
+        if(text[i] == '\\' && i + 1 < text.size())
+        {
+            token.ch = (unsigned char) text[++i];
+        }
+        else if(text[i] == '?')
+        {
+            token.kind = GLOB_ANY_CHAR;
+        }
+        else if(text[i] == '*')
+        {
+            // Runs of stars behave like one
+            if(!segment.tokens.empty() && segment.tokens.back().kind == GLOB_ANY_RUN) continue;
+            token.kind = GLOB_ANY_RUN;
+        }
+        else if(text[i] == '[')
+        {
+            size_t j = i + 1;
+            bool negate = (j < text.size() && (text[j] == '!' || text[j] == '^'));
+            if(negate) j++;
+            std::bitset<256> chars;
+            bool closed = false;
+            for(bool first = true; j < text.size(); first = false, j++)
+            {
+                if(text[j] == ']' && !first)
+                {
+                    closed = true;
+                    break;
+                }
+                unsigned char low = (unsigned char) text[j];
+                if(text[j] == '\\' && j + 1 < text.size()) low = (unsigned char) text[++j];
+                unsigned char high = low;
+                if(j + 2 < text.size() && text[j + 1] == '-' && text[j + 2] != ']')
+                {
+                    high = (unsigned char) text[j + 2];
+                    j += 2;
+                }
+                for(int c = low; c <= high; c++) chars.set(c);
+            }
+            // An unterminated '[' is just a bracket
+            if(closed)
+            {
+                if(negate) chars.flip();
+                token.kind = GLOB_CLASS;
+                token.set = (uint16_t) set->classes.size();
+                set->classes.push_back(chars);
+                i = j;
+            }
+        }
+        if(token.kind != GLOB_LITERAL) segment.literal = false;
+        segment.tokens.push_back(token);
+    }
+
+    if(segment.literal)
+    {
+        for(int i = 0; i < segment.tokens.size(); i++) segment.text += (char) segment.tokens[i].ch;
+        segment.tokens.clear();
+    }
+    return segment;
+}
+
+
+// ─── MATCHING ───────────────────────────────────────────────────────────────────
+
+
+/** Matches one name against one compiled segment
+ * Stars backtrack only to the most recent star, which keeps matching linear for typical patterns.
+ */
+static bool matchSegment(const IgnoreRules* set, const GlobSegment* segment, const char* text, size_t length)
+{
+    if(segment->literal)
+    {
+        return segment->text.size() == length && memcmp(segment->text.data(), text, length) == 0;
+    }
+
+    const std::vector<GlobToken>& tokens = segment->tokens;
+    size_t t = 0;
+    size_t i = 0;
+    size_t star_token = std::string::npos;
+    size_t star_text = 0;
+    while(i < length)
+    {
+        if(t < tokens.size() && tokens[t].kind == GLOB_ANY_RUN)
+        {
+            star_token = t++;
+            star_text = i;
+            continue;
+        }
+        if(t < tokens.size())
+        {
+            const GlobToken *token = &tokens[t];
+            unsigned char c = (unsigned char) text[i];
+            bool matched = (token->kind == GLOB_ANY_CHAR) ||
+                           (token->kind == GLOB_LITERAL && token->ch == c) ||
+                           (token->kind == GLOB_CLASS && set->classes[token->set].test(c));
+            if(matched)
+            {
+                t++;
+                i++;
+                continue;
+            }
+        }
+        if(star_token == std::string::npos) return false;
+        t = star_token + 1;
+        i = ++star_text;
+    }
+    while(t < tokens.size() && tokens[t].kind == GLOB_ANY_RUN) t++;
+    return t == tokens.size();
+}
+
+/** Matches an anchored rule's segments against the level prefix followed by the entry name
+ * @param si Index of the next rule segment
+ * @param pi Index of the next path segment, the name comes after the prefix
+ */
+static bool matchPath(const IgnoreRules* set, const IgnoreRule* rule, size_t si, const IgnoreLevel* level, const char* name, size_t pi)
+{
+    size_t count = level->prefix.size() + 1;
+    if(si == rule->segments.size()) return pi == count;
+
+    const GlobSegment *segment = &rule->segments[si];
+    if(segment->any_depth)
+    {
+        // A trailing ** matches everything inside, a leading or middle one zero or more directories
+        if(si + 1 == rule->segments.size()) return pi < count;
+        for(size_t k = pi; k < count; k++)
+        {
+            if(matchPath(set, rule, si + 1, level, name, k)) return true;
+        }
+        return false;
+    }
+
+    if(pi == count) return false;
+    bool matched = (pi < level->prefix.size())
+                 ? matchSegment(set, segment, level->prefix[pi].data(), level->prefix[pi].size())
+                 : matchSegment(set, segment, name, strlen(name));
+    return matched && matchPath(set, rule, si + 1, level, name, pi + 1);
+}
+
+/** Checks a single rule against a directory entry
+ */
+static bool ruleMatches(const IgnoreRules* set, const IgnoreRule* rule, const IgnoreLevel* level, const char* name, size_t length, bool is_dir)
+{
+    if(rule->dir_only && !is_dir) return false;
+    // Patterns without a slash match the name at any depth, a bare ** matches every name
+    if(!rule->anchored) return rule->segments[0].any_depth || matchSegment(set, &rule->segments[0], name, length);
+    if(rule->fixed_depth && rule->segments.size() != level->prefix.size() + 1) return false;
+    return matchPath(set, rule, 0, level, name, 0);
+}
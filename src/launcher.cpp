@@ -0,0 +1,317 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <spawn.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include "launcher.h"
+
+extern char **environ;
+
+// Handler command lines, split into words, keyed by file Type
+static std::map<Type, std::vector<std::string>> handlers;
+// Pids of the handlers still running, 0 for a free slot. Only these are reaped,
+// children started by anything else are left for their owner to wait on.
+static std::atomic<pid_t> children[LAUNCHER_MAX_CHILDREN];
+
+static void reapChildren(int signum);
+static bool trackChild(pid_t pid);
+static std::vector<std::string> splitCommand(std::string command);
+static bool parseTypeName(std::string name, Type* type);
+static int spawnHandler(std::vector<std::string> command, std::vector<File*> files, int first, int count);
+
+
+// ─── SETUP ──────────────────────────────────────────────────────────────────────
+
+
+/** Installs the SIGCHLD reaper and loads the user's handler configuration
+ */
+void initLauncher()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = reapChildren;
+    sigemptyset(&action.sa_mask);
+    // SA_RESTART keeps the SDL event loop from seeing EINTR when a child exits
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if(sigaction(SIGCHLD, &action, NULL) != 0)
+    {
+        printf("Error: %s\n", strerror(errno));
+    }
+
+    loadLauncherHandlers(getLauncherConfigPath());
+}
+
+/** Gets the path of the handler configuration file
+ * @return $XDG_CONFIG_HOME/fileexplorer/handlers, falling back to ~/.config
+ */
+std::string getLauncherConfigPath()
+{
+    char *config_home = getenv("XDG_CONFIG_HOME");
+    if(config_home != NULL && config_home[0] != '\0')
+    {
+        return std::string(config_home) + "/fileexplorer/handlers";
+    }
+    char *home = getenv("HOME");
+    if(home == NULL) return "";
+    return std::string(home) + "/.config/fileexplorer/handlers";
+}
+
+/** Loads per-Type handler commands from a config file
+ * Each line has the form `type = command args...`, where type is one of
+ * directory, executable, image, video, code or other. In the command, %f is
+ * replaced by a single file (one process per file) and %F by every file of
+ * that type (one process for the whole batch). Lines starting with # are ignored.
+ * @param config_path Path of the configuration file. Missing files are not an error.
+ */
+void loadLauncherHandlers(std::string config_path)
+{
+    handlers.clear();
+    if(config_path == "") return;
+
+    std::ifstream config(config_path.c_str());
+    std::string line;
+    int line_number = 0;
+    while(std::getline(config, line))
+    {
+        line_number++;
+        size_t first = line.find_first_not_of(" \t");
+        if(first == std::string::npos || line[first] == '#') continue;
+
+        size_t equals = line.find('=');
+        if(equals == std::string::npos)
+        {
+            printf("%s:%d: expected `type = command`\n", config_path.c_str(), line_number);
+            continue;
+        }
+
+        std::string name = line.substr(first, equals - first);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        Type type;
+        if(!parseTypeName(name, &type))
+        {
+            printf("%s:%d: unknown type `%s`\n", config_path.c_str(), line_number, name.c_str());
+            continue;
+        }
+
+        std::vector<std::string> command = splitCommand(line.substr(equals + 1));
+        if(command.empty())
+        {
+            printf("%s:%d: empty command\n", config_path.c_str(), line_number);
+            continue;
+        }
+        handlers[type] = command;
+    }
+}
+
+
+// ─── LAUNCHING ──────────────────────────────────────────────────────────────────
+
+
+/** Opens a batch of files with the handler configured for their type
+ * Files sharing a handler that takes %F are opened by a single process.
+ * @param files Files to open
+ * @return Number of processes that failed to start
+ */
+int launchFiles(std::vector<File*> files)
+{
+    // Group the files by type, keeping their on-screen order
+    std::map<Type, std::vector<File*>> batches;
+    for(int i = 0; i < files.size(); i++)
+    {
+        batches[files[i]->type].push_back(files[i]);
+    }
+
+    std::vector<std::string> default_command = splitCommand(LAUNCHER_DEFAULT_HANDLER);
+    int failures = 0;
+    for(auto it = batches.begin(); it != batches.end(); it++)
+    {
+        auto handler = handlers.find(it->first);
+        std::vector<std::string> command = (handler != handlers.end()) ? handler->second : default_command;
+        std::vector<File*> batch = it->second;
+
+        if(std::find(command.begin(), command.end(), "%F") != command.end())
+        {
+            if(spawnHandler(command, batch, 0, batch.size()) != 0) failures++;
+        }
+        else
+        {
+            for(int i = 0; i < batch.size(); i++)
+            {
+                if(spawnHandler(command, batch, i, 1) != 0) failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+/** Starts one handler process without copying the explorer's address space
+ * posix_spawn uses vfork semantics, so the cost does not grow with the size of
+ * the loaded tree, and a failed exec is reported here instead of leaving a
+ * second copy of the explorer running.
+ * @param command Handler command words, possibly containing %f or %F
+ * @param files Files being opened
+ * @param first Index of the first file passed to this process
+ * @param count Number of files passed to this process
+ * @return 0 on success, otherwise the posix_spawn error
+ */
+static int spawnHandler(std::vector<std::string> command, std::vector<File*> files, int first, int count)
+{
+    std::vector<std::string> words;
+    bool has_placeholder = false;
+    for(int i = 0; i < command.size(); i++)
+    {
+        if(command[i] == "%F")
+        {
+            for(int j = first; j < first + count; j++) words.push_back(files[j]->path);
+            has_placeholder = true;
+        }
+        else if(command[i] == "%f")
+        {
+            words.push_back(files[first]->path);
+            has_placeholder = true;
+        }
+        else
+        {
+            words.push_back(command[i]);
+        }
+    }
+    // Handlers without a placeholder get the files appended
+    if(!has_placeholder)
+    {
+        for(int j = first; j < first + count; j++) words.push_back(files[j]->path);
+    }
+
+    std::vector<char*> argv;
+    for(int i = 0; i < words.size(); i++) argv.push_back(&words[i][0]);
+    argv.push_back(NULL);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    // Own process group, so a Ctrl+C in the launching terminal doesn't reach it
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    if(err != 0)
+    {
+        printf("Error: could not run %s: %s\n", argv[0], strerror(err));
+    }
+    else if(!trackChild(pid))
+    {
+        printf("Error: too many handlers running, %s won't be reaped\n", argv[0]);
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+}
+
+
+// ─── HELPERS ────────────────────────────────────────────────────────────────────
+
+
+/** SIGCHLD handler, collects the handlers that have exited so none are left as zombies
+ */
+static void reapChildren(int signum)
+{
+    int saved_errno = errno;
+    for(int i = 0; i < LAUNCHER_MAX_CHILDREN; i++)
+    {
+        pid_t pid = children[i].load();
+        if(pid != 0 && waitpid(pid, NULL, WNOHANG) != 0) children[i].store(0);
+    }
+    errno = saved_errno;
+}
+
+/** Remembers a spawned handler so the SIGCHLD handler reaps it
+ * @param pid Pid returned by posix_spawn
+ * @return False if every slot is taken
+ */
+static bool trackChild(pid_t pid)
+{
+    for(int i = 0; i < LAUNCHER_MAX_CHILDREN; i++)
+    {
+        pid_t expected = 0;
+        if(!children[i].compare_exchange_strong(expected, pid)) continue;
+        // A handler that exited before it was tracked raised its SIGCHLD too early
+        if(waitpid(pid, NULL, WNOHANG) != 0) children[i].store(0);
+        return true;
+    }
+    return false;
+}
+
+/** Splits a command line on whitespace, honouring single and double quotes
+ * @param command Command line to split
+ * @return The words of the command
+ */
+static std::vector<std::string> splitCommand(std::string command)
+{
+    std::vector<std::string> words;
+    std::string word;
+    bool in_word = false;
+    char quote = '\0';
+    for(int i = 0; i < command.size(); i++)
+    {
+        char c = command[i];
+        if(quote != '\0')
+        {
+            if(c == quote) quote = '\0';
+            else word.push_back(c);
+        }
+        else if(c == '\'' || c == '"')
+        {
+            quote = c;
+            in_word = true;
+        }
+        else if(c == ' ' || c == '\t')
+        {
+            if(in_word) words.push_back(word);
+            word.clear();
+            in_word = false;
+        }
+        else
+        {
+            word.push_back(c);
+            in_word = true;
+        }
+    }
+    if(in_word) words.push_back(word);
+    return words;
+}
+
+/** Converts a handler config type name into a Type
+ * @param name Type name from the config file
+ * @param type Set to the matching Type
+ * @return True if the name is known
+ */
+static bool parseTypeName(std::string name, Type* type)
+{
+    if(name == "directory") *type = Type::DIRECTORY;
+    else if(name == "executable") *type = Type::EXECUTABLE;
+    else if(name == "image") *type = Type::IMAGE;
+    else if(name == "video") *type = Type::VIDEO;
+    else if(name == "code") *type = Type::CODE;
+    else if(name == "other") *type = Type::OTHER;
+    else return false;
+    return true;
+}
@@ -0,0 +1,463 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "listing.h"
+
+// One directory of the listing, filled in by whichever thread takes it first
+typedef struct ListedDir {
+    std::string path;
+    int depth;
+    bool taken;
+    bool listed;
+    // Still on the pending stack, after the writer took it the worker popping it frees it
+    bool queued;
+    bool written;
+    // Sorted the way the rows of the window would be, without ".."
+    std::vector<File*> items;
+    // The directory of each item that is one and will be descended into, NULL for the rest
+    std::vector<struct ListedDir*> subdirs;
+} ListedDir;
+
+enum struct ListFormat {
+    TSV,
+    CSV,
+    JSON
+};
+
+static std::vector<std::thread> workers;
+static std::mutex listing_mutex;
+static std::condition_variable work_cv;
+static std::condition_variable listed_cv;
+// Used as a stack, so the directories listed next are the ones written next
+static std::vector<ListedDir*> pending;
+static std::atomic<size_t> buffered(0);
+static bool stopping = false;
+
+static bool recursive;
+static SortColumn sort_column;
+static bool sort_descending;
+static std::atomic<uint64_t> dirs_listed(0);
+
+static void listWorker();
+static ListedDir* createListedDir(std::string path, int depth);
+static void listDirectory(ListedDir* dir);
+static void waitForListing(ListedDir* dir);
+static void writeHeader(FILE* out, ListFormat format);
+static void writeEntry(FILE* out, ListFormat format, File* file, bool first);
+static void appendCsvField(std::string* line, const std::string& field);
+static void appendTsvField(std::string* line, const std::string& field);
+static void appendJsonString(std::string* line, const std::string& text);
+static std::string getTypeName(Type type);
+static bool parseListFormat(std::string name, ListFormat* format);
+static bool parseSortColumnName(std::string name, SortColumn* column);
+
+
+// ─── LISTING ────────────────────────────────────────────────────────────────────
+
+
+/** Prints the contents of a directory to stdout without opening a window
+ * Entries are written as they are listed, through the same getItemsInDirectory
+ * the window uses. With recursive set, worker threads list the subdirectories
+ * ahead of the output while it is written in a fixed order: each directory's
+ * entries sorted like the window sorts them, each subdirectory's contents right
+ * after its own entry. At most about LISTING_MAX_BUFFERED entries are held in
+ * memory at once, however large the tree.
+ * @param options What the command line asked for
+ * @return Exit status for main, 0 on success, 1 if the path can't be listed and 2 for bad options
+ */
+int runListing(const ListOptions& options)
+{
+    // The scanner reports problems with printf, so stdout is swapped for stderr
+    // and the listing goes to the real stdout through its own stream
+    fflush(stdout);
+    int out_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    FILE* out = fdopen(out_fd, "w");
+    if(out == NULL)
+    {
+        printf("Error: %s\n", strerror(errno));
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, LISTING_OUTPUT_BUFFER);
+
+    ListFormat format;
+    if(!parseListFormat(options.format, &format))
+    {
+        printf("Error: unknown format %s, expected tsv, csv or json\n", options.format.c_str());
+        return 2;
+    }
+    if(!parseSortColumnName(options.sort, &sort_column))
+    {
+        printf("Error: unknown sort %s, expected type, name, modified, size or permissions\n", options.sort.c_str());
+        return 2;
+    }
+    // Largest and newest first, like clicking their column header
+    sort_descending = (sort_column == SortColumn::SIZE || sort_column == SortColumn::MODIFIED) != options.reverse;
+    recursive = options.recursive;
+
+    struct stat info;
+    std::string root_path = options.path.size() > 1 && options.path.back() == '/' ? options.path.substr(0, options.path.size() - 1) : options.path;
+    if(stat(root_path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        printf("Error: %s: %s\n", root_path.c_str(), strerror(errno ? errno : ENOTDIR));
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    stopping = false;
+    if(recursive)
+    {
+        for(int i = 0; i < LISTING_THREADS; i++)
+        {
+            workers.push_back(std::thread(listWorker));
+        }
+    }
+
+    writeHeader(out, format);
+    uint64_t entries_written = 0;
+
+    // Depth-first over the listed directories, each frame is a directory and the next item to write
+    std::vector<std::pair<ListedDir*, size_t>> stack;
+    stack.push_back(std::make_pair(createListedDir(root_path, 0), 0));
+    while(!stack.empty())
+    {
+        ListedDir* dir = stack.back().first;
+        size_t index = stack.back().second;
+        waitForListing(dir);
+        if(index == dir->items.size())
+        {
+            freeItemVector(&dir->items);
+            stack.pop_back();
+            std::lock_guard<std::mutex> lock(listing_mutex);
+            if(dir->queued) dir->written = true;
+            else delete dir;
+            continue;
+        }
+        stack.back().second++;
+
+        writeEntry(out, format, dir->items[index], entries_written == 0);
+        entries_written++;
+        // Crossing back under the limit wakes the workers that stopped at it
+        if(buffered.fetch_sub(1) == LISTING_MAX_BUFFERED)
+        {
+            std::lock_guard<std::mutex> lock(listing_mutex);
+            work_cv.notify_all();
+        }
+        if(dir->subdirs[index] != NULL) stack.push_back(std::make_pair(dir->subdirs[index], 0));
+    }
+
+    if(format == ListFormat::JSON) fputs(entries_written == 0 ? "]\n" : "\n]\n", out);
+    fflush(out);
+
+    {
+        std::lock_guard<std::mutex> lock(listing_mutex);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    workers.clear();
+    for(int i = 0; i < pending.size(); i++)
+    {
+        delete pending[i];
+    }
+    pending.clear();
+
+    if(options.stats)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "Listed %llu entries in %llu directories in %.3f s (%.0f entries/s)\n",
+            (unsigned long long) entries_written, (unsigned long long) dirs_listed.load(), seconds, entries_written / (seconds > 0 ? seconds : 1));
+    }
+    int status = ferror(out) ? 1 : 0;
+    fclose(out);
+    return status;
+}
+
+static void listWorker()
+{
+    while(true)
+    {
+        ListedDir* dir;
+        {
+            std::unique_lock<std::mutex> lock(listing_mutex);
+            work_cv.wait(lock, []{ return stopping || (!pending.empty() && buffered < LISTING_MAX_BUFFERED); });
+            if(stopping) return;
+            dir = pending.back();
+            pending.pop_back();
+            dir->queued = false;
+            // The writer lists a directory itself rather than wait for it
+            if(dir->taken)
+            {
+                if(dir->written) delete dir;
+                continue;
+            }
+            dir->taken = true;
+        }
+        listDirectory(dir);
+    }
+}
+
+static ListedDir* createListedDir(std::string path, int depth)
+{
+    ListedDir* dir = new ListedDir();
+    dir->path = path;
+    dir->depth = depth;
+    dir->taken = false;
+    dir->listed = false;
+    dir->queued = false;
+    dir->written = false;
+    return dir;
+}
+
+/** Lists and sorts one directory, then queues its subdirectories
+ * @param dir Directory taken by the calling thread
+ */
+static void listDirectory(ListedDir* dir)
+{
+    std::vector<File*> items = getItemsInDirectory(dir->path, dir->depth, false);
+    for(int i = 0; i < items.size(); i++)
+    {
+        if(items[i]->name != "..") continue;
+        delete items[i];
+        items.erase(items.begin() + i);
+        break;
+    }
+    sortFileVector(&items, sort_column, sort_descending);
+
+    std::vector<ListedDir*> subdirs(items.size(), NULL);
+    for(int i = 0; recursive && i < items.size(); i++)
+    {
+        if(items[i]->is_dir) subdirs[i] = createListedDir(items[i]->path, dir->depth + 1);
+    }
+    dirs_listed++;
+
+    {
+        std::lock_guard<std::mutex> lock(listing_mutex);
+        dir->items.swap(items);
+        dir->subdirs.swap(subdirs);
+        dir->listed = true;
+        buffered += dir->items.size();
+        // Pushed last to first, so the first subdirectory is on top of the stack
+        for(int i = dir->subdirs.size() - 1; i >= 0; i--)
+        {
+            if(dir->subdirs[i] == NULL) continue;
+            dir->subdirs[i]->queued = true;
+            pending.push_back(dir->subdirs[i]);
+        }
+    }
+    listed_cv.notify_all();
+    work_cv.notify_all();
+}
+
+/** Blocks until a directory is listed, listing it on the calling thread if no worker has taken it
+ */
+static void waitForListing(ListedDir* dir)
+{
+    std::unique_lock<std::mutex> lock(listing_mutex);
+    if(dir->listed) return;
+    if(!dir->taken)
+    {
+        dir->taken = true;
+        lock.unlock();
+        listDirectory(dir);
+        return;
+    }
+    listed_cv.wait(lock, [dir]{ return dir->listed; });
+}
+
+
+// ─── OUTPUT ─────────────────────────────────────────────────────────────────────
+
+
+static void writeHeader(FILE* out, ListFormat format)
+{
+    if(format == ListFormat::TSV) fputs("path\ttype\tsize\tsize_text\tmtime\tmodified\tpermissions\n", out);
+    else if(format == ListFormat::CSV) fputs("path,type,size,size_text,mtime,modified,permissions\n", out);
+    else fputs("[", out);
+}
+
+/** Writes one entry as a line of the chosen format
+ * @param out Stream to write to
+ * @param format Output format
+ * @param file Entry to write
+ * @param first Whether this is the first entry, which JSON writes without a separating comma
+ */
+static void writeEntry(FILE* out, ListFormat format, File* file, bool first)
+{
+    std::string line;
+    std::string type = getTypeName(file->type);
+    std::string size = std::to_string(file->size_bytes);
+    std::string mtime = std::to_string(file->mtime);
+    if(format == ListFormat::JSON)
+    {
+        line += first ? "\n{\"path\":" : ",\n{\"path\":";
+        appendJsonString(&line, file->path);
+        line += ",\"type\":\"" + type + "\",\"size\":" + size + ",\"size_text\":";
+        appendJsonString(&line, file->size);
+        line += ",\"mtime\":" + mtime + ",\"modified\":";
+        appendJsonString(&line, file->modified);
+        line += ",\"permissions\":\"" + file->permissions + "\"}";
+    }
+    else
+    {
+        void (*append)(std::string*, const std::string&) = (format == ListFormat::CSV) ? appendCsvField : appendTsvField;
+        char separator = (format == ListFormat::CSV) ? ',' : '\t';
+        append(&line, file->path);
+        line += separator + type + separator + size + separator;
+        append(&line, file->size);
+        line += separator + mtime + separator;
+        append(&line, file->modified);
+        line += separator + file->permissions + "\n";
+    }
+    fwrite(line.data(), 1, line.size(), out);
+}
+
+/** Appends a CSV field, quoted as RFC 4180 asks when it holds a separator, quote or line break
+ */
+static void appendCsvField(std::string* line, const std::string& field)
+{
+    if(field.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        *line += field;
+        return;
+    }
+    *line += '"';
+    for(int i = 0; i < field.size(); i++)
+    {
+        if(field[i] == '"') *line += '"';
+        *line += field[i];
+    }
+    *line += '"';
+}
+
+/** Appends a TSV field, with tabs, line breaks and backslashes escaped by a backslash
+ */
+static void appendTsvField(std::string* line, const std::string& field)
+{
+    for(int i = 0; i < field.size(); i++)
+    {
+        char c = field[i];
+        if(c == '\t') *line += "\\t";
+        else if(c == '\n') *line += "\\n";
+        else if(c == '\r') *line += "\\r";
+        else if(c == '\\') *line += "\\\\";
+        else *line += c;
+    }
+}
+
+/** Appends a quoted JSON string
+ * File names are bytes rather than text, so bytes that aren't valid UTF-8 are
+ * written as U+FFFD to keep the output valid JSON.
+ */
+static void appendJsonString(std::string* line, const std::string& text)
+{
+    const unsigned char* bytes = (const unsigned char*) text.data();
+    size_t length = text.size();
+    *line += '"';
+    for(size_t i = 0; i < length;)
+    {
+        unsigned char c = bytes[i];
+        if(c < 0x80)
+        {
+            if(c == '"') *line += "\\\"";
+            else if(c == '\\') *line += "\\\\";
+            else if(c == '\n') *line += "\\n";
+            else if(c == '\t') *line += "\\t";
+            else if(c < 0x20)
+            {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                *line += escape;
+            }
+            else *line += (char) c;
+            i++;
+            continue;
+        }
+
+        // Length of the sequence and the range of its second byte, which rules out overlong forms and surrogates
+        int sequence = 0;
+        unsigned char low = 0x80, high = 0xBF;
+        if(c >= 0xC2 && c <= 0xDF) sequence = 2;
+        else if(c >= 0xE0 && c <= 0xEF)
+        {
+            sequence = 3;
+            if(c == 0xE0) low = 0xA0;
+            if(c == 0xED) high = 0x9F;
+        }
+        else if(c >= 0xF0 && c <= 0xF4)
+        {
+            sequence = 4;
+            if(c == 0xF0) low = 0x90;
+            if(c == 0xF4) high = 0x8F;
+        }
+        bool valid = sequence > 0 && i + sequence <= length && bytes[i + 1] >= low && bytes[i + 1] <= high;
+        for(int k = 2; valid && k < sequence; k++)
+        {
+            valid = bytes[i + k] >= 0x80 && bytes[i + k] <= 0xBF;
+        }
+        if(valid)
+        {
+            line->append(text, i, sequence);
+            i += sequence;
+        }
+        else
+        {
+            *line += "\\ufffd";
+            i++;
+        }
+    }
+    *line += '"';
+}
+
+/** @return The name of a type as used in the handlers config
+ */
+static std::string getTypeName(Type type)
+{
+    switch(type)
+    {
+        case Type::DIRECTORY:
+            return "directory";
+        case Type::EXECUTABLE:
+            return "executable";
+        case Type::IMAGE:
+            return "image";
+        case Type::VIDEO:
+            return "video";
+        case Type::CODE:
+            return "code";
+        case Type::OTHER:
+            return "other";
+    }
+    return "other";
+}
+
+static bool parseListFormat(std::string name, ListFormat* format)
+{
+    if(name == "tsv") *format = ListFormat::TSV;
+    else if(name == "csv") *format = ListFormat::CSV;
+    else if(name == "json") *format = ListFormat::JSON;
+    else return false;
+    return true;
+}
+
+static bool parseSortColumnName(std::string name, SortColumn* column)
+{
+    if(name == "type") *column = SortColumn::TYPE;
+    else if(name == "name") *column = SortColumn::NAME;
+    else if(name == "modified") *column = SortColumn::MODIFIED;
+    else if(name == "size") *column = SortColumn::SIZE;
+    else if(name == "permissions") *column = SortColumn::PERMISSIONS;
+    else return false;
+    return true;
+}
@@ -6,40 +6,28 @@
 #include <cstring>
 #include <string.h>
 #include <vector>
+#include <unordered_set>
+#include <unordered_map>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
-
-#define WIDTH 800
-#define HEIGHT 600
-
-#define FILES_TOP_MARGIN 60
-#define FILES_LEFT_MARGIN 40
-#define FILE_HEIGHT 30
-#define FILE_DEPTH_INDENT 10
-
-#define FILE_PERMISSIONS_X (WIDTH - 100)
-#define FILE_SIZE_X (FILE_PERMISSIONS_X - 100)
-
-#define SCROLLBAR_X WIDTH - 15
-#define SCROLLBAR_Y (FILES_TOP_MARGIN + 5)
-#define SCROLLBAR_HEIGHT (HEIGHT - SCROLLBAR_Y - 5)
-#define SCROLLBAR_HANDLE_RADIUS 5
-const SDL_Color SCROLLBAR_COLOR = {0, 0, 0, 255};
-const SDL_Color SCROLLBAR_HANDLE_COLOR = {200, 200, 200, 180};
-const SDL_Color SCROLLBAR_HANDLE_DRAG_COLOR = {200, 200, 200, 255};
-
-enum struct Type {
-    DIRECTORY,
-    EXECUTABLE,
-    IMAGE,
-    VIDEO,
-    CODE,
-    OTHER
-};
+#include <time.h>
+#include "explorer.h"
+#include "launcher.h"
+#include "fileops.h"
+#include "statqueue.h"
+#include "session.h"
+#include "assets.h"
+#include "batch.h"
+#include "ignore.h"
+#include "treemap.h"
+#include "dupes.h"
+#include "compare.h"
+#include "archive.h"
+#include "listing.h"
 
 // ! DEBUG FUNCTION
 std::string typeToString(Type t)
@@ -66,83 +54,23 @@ const std::vector<std::string> CODE_EXTENSIONS = {"h", "c", "cpp", "py", "java",
 const std::vector<std::string> IMAGE_EXTENSIONS = {"jpg", "jpeg", "png", "tif", "tiff", "gif"};
 const std::vector<std::string> VIDEO_EXTENSIONS = {"mp4", "mov", "mkv", "avi", "webm"};
 
-class File {
-    public:
-        std::string name;
-        bool is_dir;
-        std::string extension;
-        std::string permissions;
-        std::string size;
-        Type type;
-        bool is_expanded;
-        std::vector<File*> sub_files;
-        int depth;
-        std::string path;
-        std::vector<SDL_Texture*> textures;
-};
-
-typedef struct AppData {
-    TTF_Font *font;
-
-    // -- Files -- //
-    std::vector<File*> files;
-
-    SDL_Texture *Directory;
-    SDL_Texture *Executable;
-    SDL_Texture *Image;
-    SDL_Texture *Video;
-    SDL_Texture *Code;
-    SDL_Texture *Other;
-    SDL_Texture *Path;
-    SDL_Texture *Plus;
-    SDL_Texture *Minus;
-
-    std::string PathText;
-
-    SDL_Rect Path_rect;
-    SDL_Rect Path_container;
-    SDL_Rect Display_buffer;
-
-    SDL_Rect Icon_rect;
-    SDL_Rect Text_rect;
-    SDL_Rect Size_rect;
-    SDL_Rect Perm_rect;
-    SDL_Rect Expand_rect;
-
-    // Render Values -
-    int num_files;
-    int page_height;
-    int files_height;
-
-    // Scrolling -
-    int scroll_offset;
-    float scrollbar_ratio;
-    bool scrollbar_enabled;
-    SDL_Rect scrollbar_guide_rect;
-    SDL_Rect scrollbar_handle_rect;
-    int scrollbar_click_xoff;
-    int scrollbar_click_yoff;
-    bool scrollbar_drag;
-
-} AppData;
-
 void initialize(SDL_Renderer *renderer, AppData *data);
 void render(SDL_Renderer *renderer, AppData *data);
-void generateTextTextures(SDL_Renderer* renderer, AppData* data, std::vector<File*> files);
 
 void resetRenderData(AppData *data);
 
-std::vector<File*> getItemsInDirectory(std::string dirpath, int depth);
-void freeItemVector(std::vector<File*> *vector_ptr);
-std::string parsePermission(mode_t permission_mode);
-std::string parseSize(size_t byte_size);
-Type parseType(File* file);
-bool doesContain(std::string str, std::vector<std::string> vec);
+void toggleExpanded(SDL_Renderer* renderer, AppData* data, int file_index);
 void collapseFiles(AppData* data, File* file, std::vector<File*> sub_files, int start_index);
+bool isExpandable(File* file);
 
 void setPath(AppData *data, std::string path);
+void updatePathText(SDL_Renderer *renderer, AppData *data, std::string text);
+void setStatus(SDL_Renderer *renderer, AppData *data, std::string text);
 void setFiles(SDL_Renderer *renderer, AppData *data, std::vector<File*> newFiles);
-int renderFiles(SDL_Renderer *renderer, AppData *data, std::vector<File*> files);
+void freeRows(AppData *data);
+void scheduleVisibleStats(AppData* data);
+void statHandler(SDL_Renderer* renderer, AppData* data);
+int renderFiles(SDL_Renderer *renderer, AppData *data, const std::vector<File*>& files);
 
 void updateScrollbarRatio(AppData* data);
 void updateScrollbarPosition(AppData* data, int mouse_y);
@@ -151,6 +79,57 @@ void renderScrollbar(SDL_Renderer* renderer, AppData* data);
 void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
 void releaseHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
 void motionHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
+void keyHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
+void textHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
+std::vector<File*> getSelectedFiles(AppData* data);
+void clearSelection(AppData* data);
+
+int findFileRow(AppData* data, std::string path);
+void removeFileRow(AppData* data, int index);
+void removeFileRows(AppData* data, const std::vector<File*>& files);
+void freeFileRow(File* file);
+int insertFileRows(SDL_Renderer* renderer, AppData* data, const std::vector<File*>& files);
+void refreshDirectory(SDL_Renderer* renderer, AppData* data, std::string dirpath);
+void refreshFileStat(File* file, File* listed);
+void refreshAllDirectories(SDL_Renderer* renderer, AppData* data);
+bool showsDirectoryListing(AppData* data);
+
+std::vector<File*> getItemsInArchive(SDL_Renderer* renderer, AppData* data, File* dir);
+File* createArchiveRow(File* dir, const ArchiveEntry* entry);
+void archiveHandler(SDL_Renderer* renderer, AppData* data);
+
+void updateColumnHeaders(SDL_Renderer* renderer, AppData* data);
+void sortFiles(SDL_Renderer* renderer, AppData* data, SortColumn column, bool descending);
+void sortExpandedFiles(std::vector<File*>* files, SortColumn column, bool descending);
+void flattenFiles(std::vector<File*>* rows, const std::vector<File*>& files);
+
+void toggleTreemap(SDL_Renderer* renderer, AppData* data);
+void updateTreemap(SDL_Renderer* renderer, AppData* data);
+void treemapHandler(SDL_Renderer* renderer, AppData* data);
+void treemapClickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
+void renderTreemap(SDL_Renderer* renderer, AppData* data);
+std::string getTreemapStatusText(TreemapProgress* progress);
+
+void toggleDuplicates(SDL_Renderer* renderer, AppData* data);
+void startDuplicates(SDL_Renderer* renderer, AppData* data);
+void duplicatesHandler(SDL_Renderer* renderer, AppData* data);
+File* createDuplicateRow(AppData* data, const DuplicateGroup& group);
+void forgetDuplicateMember(AppData* data, std::string path);
+void pruneDuplicateGroups(AppData* data);
+std::string getDuplicatesStatusText(DuplicateProgress* progress);
+
+void startCompareView(SDL_Renderer* renderer, AppData* data, std::string left, std::string right, bool check_content);
+void leaveCompareView(SDL_Renderer* renderer, AppData* data);
+void compareHandler(SDL_Renderer* renderer, AppData* data);
+void rebuildCompareRows(SDL_Renderer* renderer, AppData* data);
+std::vector<File*> createCompareRows(CompareNode* node, int depth, const std::unordered_set<CompareNode*>& expanded, const std::unordered_set<CompareNode*>& selected);
+File* createCompareRow(CompareNode* node, int depth);
+std::string getCompareStatusText(CompareProgress* progress);
+
+void fileOpsHandler(SDL_Renderer* renderer, AppData* data);
+void queueSelectionOp(SDL_Renderer* renderer, AppData* data, OpKind kind);
+std::string getProgressText(FileOpProgress* progress);
+std::string getResultText(FileOpResult* result);
 
 
 // ─── MAIN ───────────────────────────────────────────────────────────────────────
@@ -158,9 +137,52 @@ void motionHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data);
 
 int main(int argc, char **argv)
 {
+    // --lazy-stat builds rows from readdir alone and fills in metadata as rows come into view
+    bool lazy_stat = false;
+    // --no-session starts in $HOME instead of restoring the last view
+    bool use_session = true;
+    // --no-ignore lists everything .gitignore files and the user's ignore list would hide
+    bool use_ignore = true;
+    // --compare OLD NEW starts in the compare view of two directories
+    std::string compare_left, compare_right;
+    // --list PATH prints the directory to stdout and exits without opening a window, see listing.h
+    ListOptions list;
+    list.recursive = false;
+    list.format = "tsv";
+    list.sort = "name";
+    list.reverse = false;
+    list.stats = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--lazy-stat") == 0) lazy_stat = true;
+        else if(strcmp(argv[i], "--no-session") == 0) use_session = false;
+        else if(strcmp(argv[i], "--no-ignore") == 0) use_ignore = false;
+        else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc)
+        {
+            compare_left = argv[++i];
+            compare_right = argv[++i];
+        }
+        else if(strcmp(argv[i], "--list") == 0 && i + 1 < argc) list.path = argv[++i];
+        else if(strcmp(argv[i], "--recursive") == 0) list.recursive = true;
+        else if(strncmp(argv[i], "--format=", 9) == 0) list.format = argv[i] + 9;
+        else if(strncmp(argv[i], "--sort=", 7) == 0) list.sort = argv[i] + 7;
+        else if(strcmp(argv[i], "--reverse") == 0) list.reverse = true;
+        else if(strcmp(argv[i], "--stats") == 0) list.stats = true;
+    }
+
+    // compile the user's ignore list before anything is listed
+    initIgnore();
+    setIgnoreOptions(true, use_ignore);
+
+    // the headless listing needs nothing below, SDL is never initialized for it
+    if(list.path != "") return runListing(list);
+
     char *home = getenv("HOME");
     printf("HOME: %s\n", home);
 
+    // reap launched programs and load the per-type handlers
+    initLauncher();
+
     // initializing SDL as Video
     SDL_Init(SDL_INIT_VIDEO);
     IMG_Init(IMG_INIT_PNG);
@@ -176,8 +198,29 @@ int main(int argc, char **argv)
 
     // Initializing AppData----------------------------------------------
     AppData data;
-    setPath(&data, std::string(home));
-    std::vector<File*> files = getItemsInDirectory(home, 0);
+    std::vector<File*> files;
+
+    data.page_height = HEIGHT - FILES_TOP_MARGIN - STATUS_BAR_HEIGHT;
+
+    // The last session is drawn straight from its snapshot and checked against the disk afterwards
+    SessionState session;
+    bool restored = use_session && loadSession(getSessionPath(), data.page_height, &session);
+    struct stat session_dir;
+    if(restored && (stat(session.path.c_str(), &session_dir) != 0 || !S_ISDIR(session_dir.st_mode)))
+    {
+        discardSession(&session);
+        restored = false;
+    }
+    if(restored)
+    {
+        setPath(&data, session.path);
+        files = session.rows;
+    }
+    else
+    {
+        setPath(&data, std::string(home));
+        files = getItemsInDirectory(home, 0, lazy_stat);
+    }
     
     /*
     std::cout << "Hello!" << std::endl;
@@ -185,17 +228,87 @@ int main(int argc, char **argv)
     std::cout << "Goodbye!" << std::endl;
     */
    
-    data.page_height = HEIGHT - FILES_TOP_MARGIN;
     data.scroll_offset = 0;
     data.scrollbar_drag = false;
+    data.clipboard_cut = false;
+    data.delete_pending = false;
+    data.renaming = false;
+    data.sort_column = restored ? session.sort_column : SortColumn::NAME;
+    data.sort_descending = restored ? session.sort_descending : false;
+    data.lazy_stat = lazy_stat;
+    data.treemap_view = false;
+    data.treemap_root = NULL;
+    data.dupes_view = false;
+    data.compare_view = false;
+
+    // metadata for lazily loaded rows arrives from the stat workers with this event
+    data.stat_event = SDL_RegisterEvents(1);
+    initStatQueue(data.stat_event);
+
+    // directories that changed since the snapshot are reported with this event
+    data.session_event = SDL_RegisterEvents(1);
+
+    // disk usage totals for the treemap view arrive with this event
+    data.treemap_event = SDL_RegisterEvents(1);
+
+    // archives expanded before their index was built are filled in with this event
+    data.archive_event = SDL_RegisterEvents(1);
+    initArchives(data.archive_event);
+
+    // the merged tree of the compare view grows with this event
+    data.compare_event = SDL_RegisterEvents(1);
+
+    // duplicate groups and hashing progress arrive with this event
+    data.dupes_event = SDL_RegisterEvents(1);
+
+    // copy/move/delete run on a worker that wakes the event loop with this event
+    data.fileops_event = SDL_RegisterEvents(1);
+    initFileOps(data.fileops_event);
 
     // initialize and perform rendering loop
     initialize(renderer, &data);
     setFiles(renderer, &data, files);
 
     updateScrollbarRatio(&data);
+    if(restored && data.scrollbar_enabled)
+    {
+        data.scroll_offset = std::min(std::max(session.scroll_offset, 0), data.files_height - data.page_height);
+    }
+
+    // Only the rows on screen are decoded so far, they are shown before the rest of the snapshot
+    if(restored)
+    {
+        if(compare_left == "")
+        {
+            resetRenderData(&data);
+            render(renderer, &data);
+        }
+        if(finishSession(&session))
+        {
+            data.files = session.rows;
+        }
+        else
+        {
+            // The rows were freed with the session
+            data.files.clear();
+            restored = false;
+            setPath(&data, std::string(home));
+            updatePathText(renderer, &data, data.PathText);
+            data.sort_column = SortColumn::NAME;
+            data.sort_descending = false;
+            updateColumnHeaders(renderer, &data);
+            setFiles(renderer, &data, getItemsInDirectory(home, 0, lazy_stat));
+            data.scroll_offset = 0;
+            updateScrollbarRatio(&data);
+        }
+    }
     
+    if(compare_left != "") startCompareView(renderer, &data, compare_left, compare_right, false);
+
+    scheduleVisibleStats(&data);
+    resetRenderData(&data);
     render(renderer, &data);
+    if(restored) startSessionRevalidation(session.dirs, data.session_event);
     SDL_Event event;
     SDL_WaitEvent(&event);
     while (event.type != SDL_QUIT)
@@ -210,6 +323,63 @@ int main(int argc, char **argv)
             releaseHandler(&event, renderer, &data);
         }
 
+        // KEYBOARD HANDLING
+        else if (event.type == SDL_KEYDOWN)
+        {
+            keyHandler(&event, renderer, &data);
+        }
+        else if (event.type == SDL_TEXTINPUT)
+        {
+            textHandler(&event, renderer, &data);
+        }
+
+        // FILE OPERATION PROGRESS
+        else if (event.type == data.fileops_event)
+        {
+            fileOpsHandler(renderer, &data);
+        }
+
+        // LAZY METADATA
+        else if (event.type == data.stat_event)
+        {
+            statHandler(renderer, &data);
+        }
+
+        // TREEMAP SIZE WALK
+        else if (event.type == data.treemap_event)
+        {
+            treemapHandler(renderer, &data);
+        }
+
+        // DUPLICATE SCAN
+        else if (event.type == data.dupes_event)
+        {
+            duplicatesHandler(renderer, &data);
+        }
+
+        // ARCHIVE INDEXES
+        else if (event.type == data.archive_event)
+        {
+            archiveHandler(renderer, &data);
+        }
+
+        // TREE COMPARISON
+        else if (event.type == data.compare_event)
+        {
+            compareHandler(renderer, &data);
+        }
+
+        // SESSION REVALIDATION
+        else if (event.type == data.session_event)
+        {
+            std::string stale_path;
+            // The duplicate and compare views aren't directory listings, there is nothing to bring up to date
+            while(popStaleDirectory(&stale_path))
+            {
+                if(showsDirectoryListing(&data)) refreshDirectory(renderer, &data, stale_path);
+            }
+        }
+
         // DRAG HANDLING
         if(event.type == SDL_MOUSEMOTION)
         {
@@ -217,9 +387,9 @@ int main(int argc, char **argv)
         } else
 
         // MOUSE WHEEL HANDLING
-        if (event.type == SDL_MOUSEWHEEL);
+        if (event.type == SDL_MOUSEWHEEL)
         {
-            if(data.scrollbar_enabled && event.wheel.y <= 5 && event.wheel.y >= -5) {
+            if(!data.treemap_view && data.scrollbar_enabled && event.wheel.y <= 5 && event.wheel.y >= -5) {
                 data.scroll_offset -= event.wheel.y << 4;
                 // Don't allow to scroll above files (offset inverted)
                 if(data.scroll_offset < 0) data.scroll_offset = 0;
@@ -227,19 +397,30 @@ int main(int argc, char **argv)
             }
         }
 
+        scheduleVisibleStats(&data);
         resetRenderData(&data);
         render(renderer, &data);
         SDL_WaitEvent(&event);
     }
 
     // clean up
+    stopSessionRevalidation();
+    stopTreemapWalk();
+    stopDuplicateScan();
+    // The last directory listing is still saved, the duplicate and compare views are not reopened on start
+    if(use_session && showsDirectoryListing(&data)) saveSession(&data, getSessionPath());
+    stopCompare();
+    shutdownArchives();
+    shutdownFileOps();
+    shutdownStatQueue();
+    shutdownBatchRenderer();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();
     IMG_Quit();
     SDL_Quit();
 
-    freeItemVector(&files);
+    freeRows(&data);
 
     return 0;
 }
@@ -258,139 +439,85 @@ void initialize(SDL_Renderer *renderer, AppData *data)
     // set color of background when erasing frame
     SDL_SetRenderDrawColor(renderer, 235, 235, 235, 255);
 
-    /*-----------------------Initializing Textures-----------------------*/
-    SDL_Surface *img_surf = IMG_Load("resrc/File Icons/DirectoryIcon.png");
-    data->Directory = SDL_CreateTextureFromSurface(renderer, img_surf);
-    SDL_FreeSurface(img_surf);
-
-    SDL_Surface *img2_surf = IMG_Load("resrc/File Icons/ExeIcon.png");
-    data->Executable = SDL_CreateTextureFromSurface(renderer, img2_surf);
-    SDL_FreeSurface(img2_surf);
-    
-    SDL_Surface *img3_surf = IMG_Load("resrc/File Icons/ImageIcon.png");
-    data->Image = SDL_CreateTextureFromSurface(renderer, img3_surf);
-    SDL_FreeSurface(img3_surf);
-    
-    SDL_Surface *img4_surf = IMG_Load("resrc/File Icons/VideoIcon.png");
-    data->Video = SDL_CreateTextureFromSurface(renderer, img4_surf);
-    SDL_FreeSurface(img4_surf);
-    
-    SDL_Surface *img5_surf = IMG_Load("resrc/File Icons/CodeIcon.png");
-    data->Code = SDL_CreateTextureFromSurface(renderer, img5_surf);
-    SDL_FreeSurface(img5_surf);
-    
-    SDL_Surface *img6_surf = IMG_Load("resrc/File Icons/OtherIcon.png");
-    data->Other = SDL_CreateTextureFromSurface(renderer, img6_surf);
-    SDL_FreeSurface(img6_surf);
-
-    SDL_Surface *plus_surf = IMG_Load("resrc/plus.png");
-    data->Plus = SDL_CreateTextureFromSurface(renderer, plus_surf);
-    SDL_FreeSurface(plus_surf);
-    
-    SDL_Surface *minus_surf = IMG_Load("resrc/minus.png");
-    data->Minus = SDL_CreateTextureFromSurface(renderer, minus_surf);
-    SDL_FreeSurface(minus_surf);
-    
-    /*-----------------------Initializing Text Textures------------------------*/
-    data->font = TTF_OpenFont("resrc/OpenSans-Regular.ttf", 12);
-    SDL_Color color = {0, 0, 0};
-    SDL_Surface *path_surface = TTF_RenderText_Solid(data->font, data->PathText.c_str(), color);
-    data->Path = SDL_CreateTextureFromSurface(renderer, path_surface);
-    SDL_FreeSurface(path_surface);
-
-    generateTextTextures(renderer, data, data->files);
+    /*-----------------------Initializing Atlas--------------------------*/
+    // Icons and the font are embedded in the binary, their pixels are packed into
+    // one atlas texture so each frame is drawn with a single geometry call
+    data->font = openEmbeddedFont(12);
+    initBatchRenderer(renderer, data->font);
+    data->PathDisplay = data->PathText;
 
 
     /*-----------------------Initializing Rectangles----------------------*/
     // My_rect = {x, y, width, height}
 
     data->Path_container = {10, 10, 780, 40};
-    data->Display_buffer = {10, 0, 800, 50};
+    data->Display_buffer = {0, 0, WIDTH, FILES_TOP_MARGIN};
+    data->Header_container = {10, COLUMN_HEADER_Y, WIDTH - 20, COLUMN_HEADER_HEIGHT};
+    data->Status_container = {0, HEIGHT - STATUS_BAR_HEIGHT, WIDTH, STATUS_BAR_HEIGHT};
+    data->Status_rect = {10, HEIGHT - STATUS_BAR_HEIGHT + 2, 0, 0};
 
-    data->Path_rect = {20, 21, 50, 50};
-    SDL_QueryTexture(data->Path, NULL, NULL, &(data->Path_rect.w), &(data->Path_rect.h));
+    data->Path_rect = {20, 21, 0, 0};
+    data->Treemap_area = {10, COLUMN_HEADER_Y, WIDTH - 20, HEIGHT - COLUMN_HEADER_Y - STATUS_BAR_HEIGHT - 5};
     
     data->Icon_rect = {20, 60, 30, 30};  
 
     data->scrollbar_guide_rect = {SCROLLBAR_X, SCROLLBAR_Y, 1, SCROLLBAR_HEIGHT};
 
     data->Expand_rect = {0, 0, 20, 20};
-}
-
-void generateTextTextures(SDL_Renderer* renderer, AppData* data, std::vector<File*> files)
-{
-    // printf("Generating Text Textures for %ld files.\n", files.size());
-    int j;
-    for(j = 0; j < files.size(); j++){
-
-        // -- File Name -- //
-        SDL_Color color = {0, 0, 0, 255};
-        SDL_Surface *text_surface = TTF_RenderText_Solid(data->font, files[j]->name.c_str(), color);
-        if(text_surface != NULL)
-        {
-            files[j]->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface));
-            SDL_FreeSurface(text_surface);
-        }
-        else
-        {
-            printf("FAILED TO GENERATE FILE NAME TEXT\n");
-        }
-
-        // -- File Size -- //
-        SDL_Surface *text_surface2 = TTF_RenderText_Solid(data->font, files[j]->size.c_str(), color);
-        if(text_surface2 != NULL)
-        {
-            files[j]->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface2));
-            SDL_FreeSurface(text_surface2);
-        }
-        else
-        {
-            printf("FAILED TO GENERATE FILE SIZE TEXT\n");
-        }
-        
-
 
-        // -- File Permissions -- //
-        SDL_Surface *text_surface3 = TTF_RenderText_Solid(data->font, files[j]->permissions.c_str(), color);
-        if(text_surface3 != NULL)
-        {
-            files[j]->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface3));
-            SDL_FreeSurface(text_surface3);
-        }
-        else
-        {
-            printf("FAILED TO GENERATE FILE PERM TEXT\n");
-        }
-        
-        
-        
-    }
+    /*-----------------------Initializing Column Headers------------------*/
+    data->Header_rects[(int)SortColumn::TYPE] = {FILES_LEFT_MARGIN, COLUMN_HEADER_Y + 3, 0, 0};
+    data->Header_rects[(int)SortColumn::NAME] = {FILES_LEFT_MARGIN + 40, COLUMN_HEADER_Y + 3, 0, 0};
+    data->Header_rects[(int)SortColumn::MODIFIED] = {FILE_MODIFIED_X, COLUMN_HEADER_Y + 3, 0, 0};
+    data->Header_rects[(int)SortColumn::SIZE] = {FILE_SIZE_X, COLUMN_HEADER_Y + 3, 0, 0};
+    data->Header_rects[(int)SortColumn::PERMISSIONS] = {FILE_PERMISSIONS_X, COLUMN_HEADER_Y + 3, 0, 0};
+    updateColumnHeaders(renderer, data);
 }
 
 void render(SDL_Renderer *renderer, AppData *data){
+    const SDL_Color text_color = {0, 0, 0, 255};
+    const SDL_Color background_color = {0xFF, 0xFF, 0xFF, 0xFF};
+    const SDL_Color path_color = {0xd9, 0xdb, 0xb9, 0xFF};
+
     // erase renderer content
     SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(renderer);
-    
-    // TODO: draw!
+
+    // Everything below is queued in draw order and submitted as one batch
+    beginBatch();
 
     // -- Render Files -- //
-    renderFiles(renderer, data, data->files);
+    if(!data->treemap_view) renderFiles(renderer, data, data->files);
 
     // -- Display Buffer -- //
-    SDL_RenderDrawRect(renderer, &(data->Display_buffer));
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-    SDL_RenderFillRect(renderer, &(data->Display_buffer));
+    batchFill(data->Display_buffer, background_color);
+
+    // -- Column Headers -- //
+    if(data->treemap_view)
+    {
+        renderTreemap(renderer, data);
+    }
+    else
+    {
+        batchFill(data->Header_container, COLUMN_HEADER_COLOR);
+        for(int i = 0; i < NUM_SORT_COLUMNS; i++)
+        {
+            batchText(data->HeaderText[i], data->Header_rects[i].x, data->Header_rects[i].y, text_color);
+        }
+    }
 
     // -- Path Display -- //
-    SDL_RenderDrawRect(renderer, &(data->Path_container));
-    SDL_SetRenderDrawColor(renderer, 0xd9, 0xdb, 0xb9, 0xFF);
-    SDL_RenderFillRect(renderer, &(data->Path_container));
-    SDL_QueryTexture(data->Path, NULL, NULL, &(data->Path_rect.w), &(data->Path_rect.h));
-    SDL_RenderCopy(renderer, data->Path, NULL, &(data->Path_rect));
+    batchFill(data->Path_container, path_color);
+    batchText(data->PathDisplay, data->Path_rect.x, data->Path_rect.y, text_color);
+
+    // -- Status Bar -- //
+    batchFill(data->Status_container, STATUS_BAR_COLOR);
+    batchText(data->StatusText, data->Status_rect.x, data->Status_rect.y, text_color);
 
     // -- Render Scroll Bar -- //
-    renderScrollbar(renderer, data);
+    if(!data->treemap_view) renderScrollbar(renderer, data);
+
+    submitBatch(renderer);
 
     // show rendered frame
     SDL_RenderPresent(renderer);
@@ -402,9 +529,11 @@ void render(SDL_Renderer *renderer, AppData *data){
 
 /** Get all the file/directory items at the given dirpath
  * @param dirpath Path of the directory to get the contents of.
+ * @param depth How many expanded directories deep the items are shown
+ * @param lazy Build the items from readdir alone, without stat'ing them
  * @return A vector of files and folders inside the directory.
  */
-std::vector<File*> getItemsInDirectory(std::string dirpath, int depth)
+std::vector<File*> getItemsInDirectory(std::string dirpath, int depth, bool lazy)
 {
     if(dirpath == "") dirpath = "/";
     std::vector<File*> file_vector;
@@ -413,71 +542,43 @@ std::vector<File*> getItemsInDirectory(std::string dirpath, int depth)
     if(err == 0 && S_ISDIR(dir_info.st_mode))
     {
         DIR* dir = opendir(dirpath.c_str());
+        if(dir == NULL)
+        {
+            printf("Error: %s\n", strerror(errno));
+            return file_vector;
+        }
         struct dirent *entry;
-        struct stat entry_info;
-        std::string full_path;
+        IgnoreContext ignore = getIgnoreContext(dirpath);
 
-        int dot_pos;
-
-        int first_file = 0;
-        int search_index, search_end;
-        
         while((entry = readdir(dir)) != NULL)
         {
-            File* file_entry = new File();
-            file_entry->name = entry->d_name;
-            file_entry->path = dirpath + "/" + file_entry->name;
-            file_entry->depth = depth;
-            if(file_entry->name == ".") continue;
-            file_entry->is_dir = (entry->d_type == DT_DIR);
-            file_entry->is_expanded = false;
-            // get file stat
-            full_path = dirpath + "/" + file_entry->name;
-            stat(full_path.c_str(), &entry_info);
-            // extract extension
-            // if a . is found
-            if((dot_pos = file_entry->name.find_last_of('.')) != file_entry->name.npos) {
-                // set the extension to every character after the .
-                file_entry->extension = file_entry->name;
-                file_entry->extension = file_entry->extension.erase(0, dot_pos+1);
-            } else {
-                file_entry->extension = "";
+            if(strcmp(entry->d_name, ".") == 0) continue;
+
+            // d_type is enough to tell directories apart, except on filesystems that leave it unknown
+            struct stat entry_info;
+            bool have_info = false;
+            bool is_dir = (entry->d_type == DT_DIR);
+            // Hidden and ignored entries are dropped before they cost a stat or an allocation
+            if(entry->d_type != DT_UNKNOWN && isIgnoredEntry(&ignore, entry->d_name, is_dir)) continue;
+            if(entry->d_type == DT_UNKNOWN || !lazy)
+            {
+                have_info = (fstatat(dirfd(dir), entry->d_name, &entry_info, 0) == 0);
+                if(!have_info) memset(&entry_info, 0, sizeof(entry_info));
+                if(entry->d_type == DT_UNKNOWN) is_dir = S_ISDIR(entry_info.st_mode);
             }
+            if(entry->d_type == DT_UNKNOWN && isIgnoredEntry(&ignore, entry->d_name, is_dir)) continue;
 
-            // extract permissions
-            file_entry->permissions = parsePermission(entry_info.st_mode);
-            
-            // extract size
-            file_entry->size = parseSize(entry_info.st_size);
-
-            // extract type
-            file_entry->type = parseType(file_entry);
+            File* file_entry = createLazyFileEntry(dirpath, entry->d_name, depth, is_dir);
+            if(have_info || !lazy) applyFileStat(file_entry, &entry_info);
 
             //printf("%-40s - %s\n", file_entry->name.c_str(), typeToString(file_entry->type).c_str());
 
-            // smarter adding
-            if(file_entry->is_dir)
-            {
-                search_index = 0;
-                search_end = first_file;
-            }
-            else
-            {
-                search_index = first_file;
-                search_end = file_vector.size();
-            }
-
-            while(search_index < search_end)
-            {
-                // compare the name strings. if new < index, break
-                if(file_entry->name < file_vector.at(search_index)->name) break;
-                search_index++;
-            }
-            
-            auto it = file_vector.begin() + search_index;
-            file_vector.insert(it, file_entry);
-            if(file_entry->is_dir) first_file++;
+            file_vector.push_back(file_entry);
         }
+        // directories first, then by name
+        rankFileNames(&file_vector);
+        sortFileVector(&file_vector, SortColumn::NAME, false);
+        closedir(dir);
     }
     else
     {
@@ -486,6 +587,147 @@ std::vector<File*> getItemsInDirectory(std::string dirpath, int depth)
     return file_vector;
 }
 
+/** Creates a file entry for an item inside a directory
+ * @param dirpath Path of the directory holding the item
+ * @param name Name of the item
+ * @param depth How many expanded directories deep the item is shown
+ * @param is_dir Whether the item is a directory
+ * @return The new file entry
+ */
+File* createFileEntry(std::string dirpath, std::string name, int depth, bool is_dir)
+{
+    File* file_entry = createLazyFileEntry(dirpath, name, depth, is_dir);
+    struct stat entry_info;
+    // get file stat
+    if(stat(file_entry->path.c_str(), &entry_info) != 0)
+    {
+        memset(&entry_info, 0, sizeof(entry_info));
+    }
+    applyFileStat(file_entry, &entry_info);
+    return file_entry;
+}
+
+/** Creates a file entry from its name alone, leaving the metadata columns pending
+ * @param dirpath Path of the directory holding the item
+ * @param name Name of the item
+ * @param depth How many expanded directories deep the item is shown
+ * @param is_dir Whether the item is a directory
+ * @return The new file entry, with has_stat unset
+ */
+File* createLazyFileEntry(std::string dirpath, std::string name, int depth, bool is_dir)
+{
+    File* file_entry = new File();
+    int dot_pos;
+
+    file_entry->name = name;
+    file_entry->path = joinPath(dirpath, name);
+    file_entry->depth = depth;
+    file_entry->is_dir = is_dir;
+    file_entry->is_expanded = false;
+    file_entry->is_selected = false;
+    file_entry->has_stat = false;
+    file_entry->is_virtual = false;
+    file_entry->diff = DiffKind::NONE;
+    file_entry->compare_node = NULL;
+    // Archives are browsed like directories, their members are given the same archive
+    file_entry->archive = (!is_dir && isArchiveName(name)) ? file_entry->path : "";
+    // extract extension
+    // if a . is found
+    if((dot_pos = file_entry->name.find_last_of('.')) != file_entry->name.npos) {
+        // set the extension to every character after the .
+        file_entry->extension = file_entry->name;
+        file_entry->extension = file_entry->extension.erase(0, dot_pos+1);
+    } else {
+        file_entry->extension = "";
+    }
+
+    file_entry->permissions = PENDING_STAT_TEXT;
+    file_entry->size = PENDING_STAT_TEXT;
+    file_entry->modified = PENDING_STAT_TEXT;
+
+    // extract type, executables are only known once the permissions are
+    file_entry->type = parseType(file_entry);
+
+    // sort keys, ".." stays on top, then directories, then files
+    file_entry->sort_group = (file_entry->name == "..") ? 0 : (file_entry->is_dir ? 1 : 2);
+    file_entry->size_bytes = 0;
+    file_entry->mtime = 0;
+    file_entry->mode = 0;
+    file_entry->name_rank = 0;
+    file_entry->collate_name = file_entry->name;
+    std::transform(file_entry->collate_name.begin(), file_entry->collate_name.end(), file_entry->collate_name.begin(), ::tolower);
+    // the first 8 bytes, big-endian, so most name comparisons never touch the string
+    file_entry->name_key = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        unsigned char c = (i < file_entry->collate_name.size()) ? file_entry->collate_name[i] : 0;
+        file_entry->name_key = (file_entry->name_key << 8) | c;
+    }
+
+    return file_entry;
+}
+
+/** Fills in the metadata columns and sort keys of a file from its stat
+ * @param file File to update
+ * @param info Result of stat() on the file
+ */
+void applyFileStat(File* file, const struct stat* info)
+{
+    // extract permissions
+    file->permissions = parsePermission(info->st_mode);
+
+    // extract size
+    file->size = parseSize(info->st_size);
+
+    // extract modified time
+    file->modified = parseTime(info->st_mtime);
+
+    // extract type
+    file->type = parseType(file);
+
+    file->size_bytes = info->st_size;
+    file->mtime = info->st_mtime;
+    file->mode = info->st_mode;
+    file->has_stat = true;
+}
+
+/** Creates a file entry for a single path
+ * @param path Path of the item
+ * @param depth How many expanded directories deep the item is shown
+ * @return The new file entry, or NULL if the path doesn't exist
+ */
+File* getFileInfo(std::string path, int depth)
+{
+    struct stat info;
+    if(lstat(path.c_str(), &info) != 0) return NULL;
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    return createFileEntry(parentPath(path), name, depth, S_ISDIR(info.st_mode));
+}
+
+/** Joins a directory path and a name without doubling the separator
+ */
+std::string joinPath(std::string dirpath, std::string name)
+{
+    if(dirpath.size() > 0 && dirpath.back() == '/') return dirpath + name;
+    return dirpath + "/" + name;
+}
+
+/** Gets the path of the directory containing a path
+ */
+std::string parentPath(std::string path)
+{
+    size_t slash = path.find_last_of('/');
+    if(slash == std::string::npos || slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+/** @return Whether a row lies inside an archive, rather than on disk
+ */
+bool isArchiveMember(File* file)
+{
+    return file->archive != "" && file->path != file->archive;
+}
+
 /** Frees the memory of the items in the item vector
  * @param vector_ptr a pointer to the vector containing the items.
  */
@@ -494,6 +736,9 @@ void freeItemVector(std::vector<File*> *vector_ptr)
     for(int i = 0; i < vector_ptr->size(); i++)
     {
         File* fp = vector_ptr->at(i);
+        // Collapsed virtual rows are the only owners of their contents
+        if(fp->is_virtual && !fp->is_expanded) freeItemVector(&fp->sub_files);
+        forgetFileStat(fp);
         delete fp;
     }
 }
@@ -594,22 +839,46 @@ std::string parseSize(size_t byte_size) {
     return size_str;
 }
 
+/** Formats a modification time for the Modified column
+ * @param mtime Seconds since the epoch
+ * @return Local date and time, e.g. 2021-04-30 13:05
+ */
+std::string parseTime(int64_t mtime) {
+    time_t seconds = mtime;
+    struct tm local;
+    char buffer[32];
+    if(localtime_r(&seconds, &local) == NULL) return "";
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &local);
+    return std::string(buffer);
+}
+
 /** Takes a pointer to a file and returns the type of the file
  * @param file File to get type of
  * @return The type of the file
  */
 Type parseType(File* file) 
+{
+    return parseType(file->is_dir, file->permissions.find('x') != std::string::npos, file->extension);
+}
+
+/** Classifies an entry without needing a File, for walks that never build rows
+ * @param is_dir Whether the entry is a directory
+ * @param is_executable Whether any execute bit is set
+ * @param extension Characters after the last '.' of the name
+ * @return Type of the entry
+ */
+Type parseType(bool is_dir, bool is_executable, std::string extension)
 {
     // Directory
-    if(file->is_dir) return Type::DIRECTORY;
+    if(is_dir) return Type::DIRECTORY;
     // Executable
-    if(file->permissions.find('x') != std::string::npos) return Type::EXECUTABLE;
+    if(is_executable) return Type::EXECUTABLE;
     // Code file
-    if(doesContain(file->extension, CODE_EXTENSIONS)) return Type::CODE;
+    if(doesContain(extension, CODE_EXTENSIONS)) return Type::CODE;
     // Image
-    if(doesContain(file->extension, IMAGE_EXTENSIONS)) return Type::IMAGE;
+    if(doesContain(extension, IMAGE_EXTENSIONS)) return Type::IMAGE;
     // Video
-    if(doesContain(file->extension, VIDEO_EXTENSIONS)) return Type::VIDEO;
+    if(doesContain(extension, VIDEO_EXTENSIONS)) return Type::VIDEO;
     // Other
     return Type::OTHER;
 }
@@ -636,36 +905,32 @@ void setPath(AppData *data, std::string path){
     data->PathText = path;
 }
 
+/** Replaces the text shown in the path bar
+ * @param renderer Main-stage renderer
+ * @param data App Data used in rendering main-stage content
+ * @param text Text to show, normally the PathText
+ */
+void updatePathText(SDL_Renderer *renderer, AppData *data, std::string text){
+    data->PathDisplay = text;
+}
+
+/** Sets the message shown in the status bar
+ * @param renderer Main-stage renderer
+ * @param data App Data used in rendering main-stage content
+ * @param text Message to show
+ */
+void setStatus(SDL_Renderer *renderer, AppData *data, std::string text){
+    data->StatusText = text;
+}
+
 /** Sets the path text for the current file directory path
  * @param data App Data used in rendering main-stage content
  * @param newFiles Files to change the current Files into
  */
 void setFiles(SDL_Renderer *renderer, AppData *data, std::vector<File*> newFiles){
-    data->files.clear();
+    freeRows(data);
     data->files = newFiles;
     data->num_files = data->files.size();
-
-    int j;
-    File* file;
-    for(j = 0; j < data->files.size(); j++){
-        file = data->files[j];
-        file->textures.clear();
-        // -- File Name -- //
-        SDL_Color color = {0, 0, 0};
-        SDL_Surface *text_surface = TTF_RenderText_Solid(data->font, data->files[j]->name.c_str(), color);
-        file->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface));
-        SDL_FreeSurface(text_surface);
-
-        // -- File Size -- //
-        SDL_Surface *text_surface2 = TTF_RenderText_Solid(data->font, data->files[j]->size.c_str(), color);
-        file->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface2));
-        SDL_FreeSurface(text_surface2);
-
-        // -- File Permissions -- //
-        SDL_Surface *text_surface3 = TTF_RenderText_Solid(data->font, data->files[j]->permissions.c_str(), color);
-        file->textures.push_back(SDL_CreateTextureFromSurface(renderer, text_surface3));
-        SDL_FreeSurface(text_surface3);
-    }
 }
 
 /** Render all files/Icons/Size/permissions within a current path directory
@@ -673,69 +938,61 @@ void setFiles(SDL_Renderer *renderer, AppData *data, std::vector<File*> newFiles
  * @param data App Data used in rendering main-state content
  * @param files list of files within the current path directory
  */
-int renderFiles(SDL_Renderer *renderer, AppData *data, std::vector<File*> files){
+int renderFiles(SDL_Renderer *renderer, AppData *data, const std::vector<File*>& files){
+    const SDL_Color text_color = {0, 0, 0, 255};
+    const SDL_Color badge_text_color = {0xFF, 0xFF, 0xFF, 0xFF};
     int i; 
     File* file;
-    for(i = 0; i < files.size(); i++){
+    // Only rows on screen are drawn, skip straight to the first one
+    int first = data->scroll_offset / FILE_HEIGHT;
+    if(first < 0) first = 0;
+    data->Icon_rect.y += first * FILE_HEIGHT;
+    for(i = first; i < files.size() && data->Icon_rect.y < HEIGHT; i++){
         file = files[i];
-        // ----Render Icon---- //
+        int text_y = data->Icon_rect.y + 9;
 
         auto local_Icon_rect = data->Icon_rect;
         local_Icon_rect.x += (FILE_DEPTH_INDENT * file->depth);
 
-        switch(file->type)
-        {
-            case Type::DIRECTORY:
-                SDL_RenderCopy(renderer, data->Directory, NULL, &(local_Icon_rect));
-                break;
-            case Type::EXECUTABLE:
-                SDL_RenderCopy(renderer, data->Executable, NULL, &(local_Icon_rect));
-                break;
-            case Type::IMAGE:
-                SDL_RenderCopy(renderer, data->Image, NULL, &(local_Icon_rect));
-                break;
-            case Type::VIDEO:
-                SDL_RenderCopy(renderer, data->Video, NULL, &(local_Icon_rect));
-                break;
-            case Type::CODE:
-                SDL_RenderCopy(renderer, data->Code, NULL, &(local_Icon_rect));
-                break;
-            case Type::OTHER:
-                SDL_RenderCopy(renderer, data->Other, NULL, &(local_Icon_rect));
-                break;
+        // ----Render Selection---- //
+        if(file->is_selected){
+            SDL_Rect selection_rect = {0, data->Icon_rect.y, SCROLLBAR_X - SCROLLBAR_HANDLE_RADIUS - 5, FILE_HEIGHT};
+            batchFill(selection_rect, SELECTION_COLOR);
+        }
+
+        // ----Render Diff Badge---- //
+        if(file->diff != DiffKind::NONE && file->diff != DiffKind::SAME){
+            const char* marks[] = {"", "", "?", "+", "-", "~"};
+            SDL_Color badge_color = DIFF_PENDING_COLOR;
+            if(file->diff == DiffKind::ADDED) badge_color = DIFF_ADDED_COLOR;
+            else if(file->diff == DiffKind::REMOVED) badge_color = DIFF_REMOVED_COLOR;
+            else if(file->diff == DiffKind::CHANGED) badge_color = DIFF_CHANGED_COLOR;
+            SDL_Rect badge_rect = {0, data->Icon_rect.y + 7, 10, 17};
+            batchFill(badge_rect, badge_color);
+            batchText(marks[(int) file->diff], 2, text_y - 1, badge_text_color);
         }
 
+        // ----Render Icon---- //
+        batchIcon(iconForType(file->type), local_Icon_rect);
+
         // ----Render Expand---- //
-        if(file->is_dir && file->name != ".."){
+        if(isExpandable(file)){
             data->Expand_rect.x = local_Icon_rect.x - 30;
             data->Expand_rect.y = data->Icon_rect.y + 5;
-            SDL_Texture* texture = (file->is_expanded) ? (data->Minus) : (data->Plus);
-            SDL_RenderCopy(renderer, texture, NULL, &(data->Expand_rect));
+            batchIcon((file->is_expanded) ? (AtlasIcon::MINUS) : (AtlasIcon::PLUS), data->Expand_rect);
         }
     
         // ----Render Text---- //
-        
-        data->Text_rect.x = local_Icon_rect.x + 40;
-        data->Text_rect.y = local_Icon_rect.y + 9;
-        SDL_QueryTexture(file->textures[0], NULL, NULL, &(data->Text_rect.w), &(data->Text_rect.h));
-        SDL_RenderCopy(renderer, file->textures[0], NULL, &(data->Text_rect));
+        batchText(file->name, local_Icon_rect.x + 40, text_y, text_color);
 
         // ----Render Size---- //
+        if(!file->is_dir || file->is_virtual) batchText(file->size, FILE_SIZE_X, text_y, text_color);
 
-        data->Size_rect.x = FILE_SIZE_X;
-        data->Size_rect.y = data->Icon_rect.y + 9;
-        if(!file->is_dir) {
-            SDL_QueryTexture(file->textures[1], NULL, NULL, &(data->Size_rect.w), &(data->Size_rect.h));
-            SDL_RenderCopy(renderer, file->textures[1], NULL, &(data->Size_rect));
-        }
+        // ----Render Modified Time---- //
+        batchText(file->modified, FILE_MODIFIED_X, text_y, text_color);
 
         // ----Render Permissions---- //
-
-        data->Perm_rect.x = FILE_PERMISSIONS_X;
-        data->Perm_rect.y = data->Icon_rect.y + 9;
-        SDL_QueryTexture(file->textures[2], NULL, NULL, &(data->Perm_rect.w), &(data->Perm_rect.h));
-        SDL_RenderCopy(renderer, file->textures[2], NULL, &(data->Perm_rect));
-        
+        batchText(file->permissions, FILE_PERMISSIONS_X, text_y, text_color);
 
         // ----Increment Height---- //
 
@@ -787,23 +1044,15 @@ void renderScrollbar(SDL_Renderer* renderer, AppData* data)
     if(data->scrollbar_enabled)
     {
         // render line
-        SDL_SetRenderDrawColor(renderer, SCROLLBAR_COLOR.r, SCROLLBAR_COLOR.g, SCROLLBAR_COLOR.b, SCROLLBAR_COLOR.a);
-        SDL_RenderDrawRect(renderer, &data->scrollbar_guide_rect);
+        batchFill(data->scrollbar_guide_rect, SCROLLBAR_COLOR);
 
         // render grab box
-        if(data->scrollbar_drag)
-        {
-            SDL_SetRenderDrawColor(renderer, SCROLLBAR_HANDLE_DRAG_COLOR.r, SCROLLBAR_HANDLE_DRAG_COLOR.g, SCROLLBAR_HANDLE_DRAG_COLOR.b, SCROLLBAR_HANDLE_DRAG_COLOR.a);
-        }
-        else
-        {
-            SDL_SetRenderDrawColor(renderer, SCROLLBAR_HANDLE_COLOR.r, SCROLLBAR_HANDLE_COLOR.g, SCROLLBAR_HANDLE_COLOR.b, SCROLLBAR_HANDLE_COLOR.a);
-        }
+        SDL_Color handle_color = (data->scrollbar_drag) ? (SCROLLBAR_HANDLE_DRAG_COLOR) : (SCROLLBAR_HANDLE_COLOR);
         // create rectangle
         int handle_height = (int) ((float)SCROLLBAR_HEIGHT * data->scrollbar_ratio);
         float handle_offset_ratio = (float) data->scroll_offset / (float) (data->files_height - data->page_height);
         data->scrollbar_handle_rect = {SCROLLBAR_X - SCROLLBAR_HANDLE_RADIUS, SCROLLBAR_Y + (int)((float)(SCROLLBAR_HEIGHT - handle_height) * handle_offset_ratio), SCROLLBAR_HANDLE_RADIUS << 1, (int) ((float)SCROLLBAR_HEIGHT * data->scrollbar_ratio)};
-        SDL_RenderFillRect(renderer, &data->scrollbar_handle_rect);
+        batchFill(data->scrollbar_handle_rect, handle_color);
     }
 }
 
@@ -815,12 +1064,40 @@ void renderScrollbar(SDL_Renderer* renderer, AppData* data)
  */
 void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data) 
 {
+    if(data->treemap_view)
+    {
+        treemapClickHandler(event, renderer, data);
+        return;
+    }
+
     int click_y = event->button.y;
     int click_x = event->button.x;
     // First, check if the click happened in the header section, above the files
     if(click_y < FILES_TOP_MARGIN)
     {
         // HANDLE HEADER CLICKS
+        if(click_y >= COLUMN_HEADER_Y && click_y < COLUMN_HEADER_Y + COLUMN_HEADER_HEIGHT)
+        {
+            // the clicked column is the right-most header starting left of the click
+            int column = -1;
+            for(int i = 0; i < NUM_SORT_COLUMNS; i++)
+            {
+                if(click_x >= data->Header_rects[i].x - 5) column = i;
+            }
+            if(column >= 0)
+            {
+                SortColumn sort_column = (SortColumn) column;
+                bool descending;
+                if(sort_column == data->sort_column) descending = !data->sort_descending;
+                // largest and newest first is what people look for
+                else descending = (sort_column == SortColumn::SIZE || sort_column == SortColumn::MODIFIED);
+                sortFiles(renderer, data, sort_column, descending);
+            }
+        }
+    }
+    // The status bar at the bottom covers the last row
+    else if(click_y >= HEIGHT - STATUS_BAR_HEIGHT)
+    {
     }
     // Second, check if the click happened near the scrollbar
     else if(click_x >= SCROLLBAR_X - SCROLLBAR_HANDLE_RADIUS - 5)
@@ -850,7 +1127,24 @@ void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
         if(file_index < data->num_files)
         {
             clicked_file = data->files[file_index];
-            if(click_x >= (clicked_file->depth * FILE_DEPTH_INDENT) + FILES_LEFT_MARGIN)
+            // Ctrl+Click toggles the file in the selection instead of opening it
+            if((SDL_GetModState() & KMOD_CTRL) && clicked_file->name != "..")
+            {
+                // Virtual rows and archive members have no path on disk to copy, move or delete
+                if(!clicked_file->is_virtual && !isArchiveMember(clicked_file)) clicked_file->is_selected = !clicked_file->is_selected;
+            }
+            // Virtual rows and the merged directories of the compare view can't be entered, their whole row expands them
+            else if(clicked_file->is_virtual || (clicked_file->is_dir && clicked_file->compare_node != NULL))
+            {
+                toggleExpanded(renderer, data, file_index);
+            }
+            // Nothing is extracted, directories inside an archive expand in place and its files stay closed
+            else if(isArchiveMember(clicked_file))
+            {
+                if(clicked_file->is_dir) toggleExpanded(renderer, data, file_index);
+                else setStatus(renderer, data, clicked_file->name + " is inside " + clicked_file->archive.substr(clicked_file->archive.find_last_of('/') + 1) + ", extract it to open");
+            }
+            else if(click_x >= (clicked_file->depth * FILE_DEPTH_INDENT) + FILES_LEFT_MARGIN)
                 {
                 // Directory Change
                 std::string fullPath;
@@ -865,13 +1159,11 @@ void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
                     }
                     
                     setPath(data, fullPath);
-                    std::vector<File*> newFiles = getItemsInDirectory(fullPath, 0);
+                    std::vector<File*> newFiles = getItemsInDirectory(fullPath, 0, data->lazy_stat);
+                    sortFileVector(&newFiles, data->sort_column, data->sort_descending);
                     setFiles(renderer, data, newFiles);
 
-                    SDL_Color color = {0, 0, 0};
-                    SDL_Surface *path_surface = TTF_RenderText_Solid(data->font, data->PathText.c_str(), color);
-                    data->Path = SDL_CreateTextureFromSurface(renderer, path_surface);
-                    SDL_FreeSurface(path_surface);      
+                    updatePathText(renderer, data, data->PathText);
                     
                     data->num_files = data->files.size();
 
@@ -884,47 +1176,27 @@ void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
 
                 // Execute Program
                 else{
-                    int pid = fork();
-                    if(pid == 0){
-                        fullPath = clicked_file->path;
-                        char *pathArray = &fullPath[0];
-                        char openCommand[] = "xdg-open";
-                        char *const executionArguments[3] = {openCommand, pathArray, NULL};
-                        execv("/usr/bin/xdg-open", executionArguments);
+                    // Clicking a selected file opens the files of the selection in one batch
+                    std::vector<File*> toOpen;
+                    if(clicked_file->is_selected){
+                        std::vector<File*> selected = getSelectedFiles(data);
+                        for(int i = 0; i < selected.size(); i++){
+                            if(!selected[i]->is_dir) toOpen.push_back(selected[i]);
+                        }
+                    }
+                    else{
+                        toOpen.push_back(clicked_file);
                     }
+                    launchFiles(toOpen);
+                    clearSelection(data);
                 }
             }
             else
             {
                 // Expand area clicked
-                if(data->files[file_index]->is_dir && data->files[file_index]->name != "..")
+                if(isExpandable(data->files[file_index]))
                 {
-                    auto file = data->files[file_index];
-                    if(!file->is_expanded)
-                    {
-                        // printf("Expanding files\n");
-                        file->is_expanded = true;
-                        // printf("File path %s\n", file->path.c_str());
-                        file->sub_files = getItemsInDirectory(file->path, file->depth + 1);
-                        delete file->sub_files[0];
-                        file->sub_files.erase(file->sub_files.begin());
-                        data->num_files += file->sub_files.size();
-                        generateTextTextures(renderer, data, file->sub_files);
-                        // printf("Adding %ld files from %s\n", file->sub_files.size(), file->path.c_str());
-                        for(int i = 0; i < file->sub_files.size(); i++)
-                        {
-                            data->files.insert(data->files.begin() + file_index + i + 1, file->sub_files[i]);
-                        }
-                        updateScrollbarRatio(data);
-                        renderScrollbar(renderer, data);
-                    }
-                    else
-                    {
-                        collapseFiles(data, file, file->sub_files, file_index);
-                        updateScrollbarRatio(data);
-                        renderScrollbar(renderer, data);
-                    }
-
+                    toggleExpanded(renderer, data, file_index);
                 }
             }
         }
@@ -932,22 +1204,79 @@ void clickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
     }
 }
 
-void collapseFiles(AppData* data, File* file, std::vector<File*> sub_files, int start_index)
+/** Expands a directory row to show its contents below it, or collapses it again
+ * Directories are listed on every expansion, archives from their cached index and
+ * virtual rows show the sub_files they keep.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param file_index Index of the row in data->files
+ */
+void toggleExpanded(SDL_Renderer* renderer, AppData* data, int file_index)
 {
-
-    for(int i = 0; i < sub_files.size(); i++)
+    auto file = data->files[file_index];
+    if(!file->is_expanded)
     {
-        if(sub_files[i]->is_expanded) collapseFiles(data, sub_files[i], sub_files[i]->sub_files, start_index + 1 + i);
-        for(int j = 0; j < sub_files[i]->textures.size(); j++)
+        // printf("Expanding files\n");
+        file->is_expanded = true;
+        // printf("File path %s\n", file->path.c_str());
+        if(file->compare_node != NULL)
+        {
+            if(file->compare_node->scanned.load(std::memory_order_acquire))
+            {
+                file->sub_files = createCompareRows(file->compare_node, file->depth + 1, std::unordered_set<CompareNode*>(), std::unordered_set<CompareNode*>());
+            }
+        }
+        else if(file->archive != "")
         {
-            SDL_DestroyTexture(sub_files[i]->textures[j]);
+            file->sub_files = getItemsInArchive(renderer, data, file);
+        }
+        else if(!file->is_virtual)
+        {
+            file->sub_files = getItemsInDirectory(file->path, file->depth + 1, data->lazy_stat);
+            if(!file->sub_files.empty())
+            {
+                delete file->sub_files[0];
+                file->sub_files.erase(file->sub_files.begin());
+            }
+        }
+        sortFileVector(&file->sub_files, data->sort_column, data->sort_descending);
+        data->num_files += file->sub_files.size();
+        // printf("Adding %ld files from %s\n", file->sub_files.size(), file->path.c_str());
+        for(int i = 0; i < file->sub_files.size(); i++)
+        {
+            data->files.insert(data->files.begin() + file_index + i + 1, file->sub_files[i]);
         }
     }
-    file->is_expanded = false;
-    data->files.erase(data->files.begin() + start_index + 1, data->files.begin() + start_index + 1 + sub_files.size());
+    else
+    {
+        collapseFiles(data, file, file->sub_files, file_index);
+    }
+    updateScrollbarRatio(data);
+    if(data->scroll_offset > data->files_height - data->page_height) data->scroll_offset = data->files_height - data->page_height;
+    if(data->scroll_offset < 0) data->scroll_offset = 0;
+    renderScrollbar(renderer, data);
+}
+
+/** @return Whether a row has contents to show below it, directories and archives do
+ */
+bool isExpandable(File* file)
+{
+    return (file->is_dir && file->name != "..") || (file->archive == file->path && file->compare_node == NULL);
+}
+
+void collapseFiles(AppData* data, File* file, std::vector<File*> sub_files, int start_index)
+{
+
+    for(int i = 0; i < sub_files.size(); i++)
+    {
+        if(sub_files[i]->is_expanded) collapseFiles(data, sub_files[i], sub_files[i]->sub_files, start_index + 1 + i);
+    }
+    file->is_expanded = false;
+    data->files.erase(data->files.begin() + start_index + 1, data->files.begin() + start_index + 1 + sub_files.size());
     data->num_files -= file->sub_files.size();
+    if(file->is_virtual) return;
     freeItemVector(&file->sub_files);
-    file->sub_files.empty();
+    file->sub_files.clear();
 }
 
 /** Handle any logic for mouse release events
@@ -970,4 +1299,1416 @@ void motionHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
         updateScrollbarPosition(data, event->motion.y);
         return;
     }
-}
\ No newline at end of file
+}
+
+
+// ─── KEYBOARD ───────────────────────────────────────────────────────────────────
+
+
+/** Handle any logic for key press events
+ */
+void keyHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
+{
+    SDL_Keycode key = event->key.keysym.sym;
+    bool ctrl = (event->key.keysym.mod & KMOD_CTRL) != 0;
+
+    // While renaming, keys edit the new name instead
+    if(data->renaming)
+    {
+        if(key == SDLK_RETURN || key == SDLK_ESCAPE)
+        {
+            if(key == SDLK_RETURN && data->rename_text != "" && data->rename_text.find('/') == std::string::npos)
+            {
+                FileOp op;
+                op.kind = OpKind::RENAME;
+                op.sources.push_back(data->rename_source);
+                op.destination = joinPath(parentPath(data->rename_source), data->rename_text);
+                queueFileOp(op);
+            }
+            data->renaming = false;
+            SDL_StopTextInput();
+            updatePathText(renderer, data, data->PathText);
+        }
+        else if(key == SDLK_BACKSPACE && !data->rename_text.empty())
+        {
+            data->rename_text.pop_back();
+            updatePathText(renderer, data, "Rename to: " + data->rename_text + "_");
+        }
+        return;
+    }
+
+    // Delete asks for a second press before anything is removed
+    if(key != SDLK_DELETE && data->delete_pending)
+    {
+        data->delete_pending = false;
+        setStatus(renderer, data, "");
+    }
+
+    switch(key)
+    {
+        // Open every selected file
+        case SDLK_RETURN:
+        {
+            std::vector<File*> selected = getSelectedFiles(data);
+            std::vector<File*> toOpen;
+            for(int i = 0; i < selected.size(); i++)
+            {
+                if(!selected[i]->is_dir) toOpen.push_back(selected[i]);
+            }
+            if(!toOpen.empty()) launchFiles(toOpen);
+            clearSelection(data);
+            break;
+        }
+        // Stop the running operation, otherwise drop the selection
+        case SDLK_ESCAPE:
+        {
+            FileOpProgress progress;
+            if(getFileOpProgress(&progress)) cancelFileOp();
+            else clearSelection(data);
+            break;
+        }
+        // Ctrl+C / Ctrl+X remember the selection, Ctrl+V pastes it into the current directory
+        case SDLK_c:
+        case SDLK_x:
+            if(ctrl)
+            {
+                std::vector<File*> selected = getSelectedFiles(data);
+                if(selected.empty()) break;
+                data->clipboard.clear();
+                for(int i = 0; i < selected.size(); i++) data->clipboard.push_back(selected[i]->path);
+                data->clipboard_cut = (key == SDLK_x);
+                setStatus(renderer, data, std::to_string(selected.size()) + (data->clipboard_cut ? " item(s) cut" : " item(s) copied"));
+            }
+            break;
+        case SDLK_v:
+            if(ctrl && !data->clipboard.empty())
+            {
+                FileOp op;
+                op.kind = data->clipboard_cut ? OpKind::MOVE : OpKind::COPY;
+                op.sources = data->clipboard;
+                op.destination = (data->PathText == "") ? "/" : data->PathText;
+                queueFileOp(op);
+                // A cut can only be pasted once
+                if(data->clipboard_cut) data->clipboard.clear();
+            }
+            break;
+        case SDLK_DELETE:
+        {
+            std::vector<File*> selected = getSelectedFiles(data);
+            if(selected.empty()) break;
+            if(!data->delete_pending)
+            {
+                data->delete_pending = true;
+                setStatus(renderer, data, "Press Delete again to delete " + std::to_string(selected.size()) + " item(s)");
+            }
+            else
+            {
+                data->delete_pending = false;
+                queueSelectionOp(renderer, data, OpKind::DELETE);
+            }
+            break;
+        }
+        // Ctrl+T switches between the list and the treemap of the current directory
+        case SDLK_t:
+            if(ctrl && showsDirectoryListing(data)) toggleTreemap(renderer, data);
+            break;
+        // Ctrl+D switches between the list and the duplicate files below the current directory
+        case SDLK_d:
+            if(ctrl && !data->treemap_view && !data->compare_view) toggleDuplicates(renderer, data);
+            break;
+        // Ctrl+E compares the directory copied with Ctrl+C (old) with the current one (new),
+        // with Shift the contents of files are compared too
+        case SDLK_e:
+            if(!ctrl || data->treemap_view || data->dupes_view) break;
+            if(data->compare_view)
+            {
+                leaveCompareView(renderer, data);
+            }
+            else
+            {
+                struct stat info;
+                if(data->clipboard.size() != 1 || stat(data->clipboard[0].c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+                {
+                    setStatus(renderer, data, "Copy a directory with Ctrl+C, then Ctrl+E compares it with this one");
+                    break;
+                }
+                std::string current = (data->PathText == "") ? "/" : data->PathText;
+                startCompareView(renderer, data, data->clipboard[0], current, (event->key.keysym.mod & KMOD_SHIFT) != 0);
+            }
+            break;
+        // In the treemap, F5 measures again and Backspace zooms out, in the duplicate list and comparison F5 runs again
+        case SDLK_F5:
+            if(data->treemap_view)
+            {
+                startTreemapWalk(getTreemapRootPath(), data->treemap_event);
+                data->treemap_root = getTreemapRoot();
+                updateTreemap(renderer, data);
+            }
+            else if(data->dupes_view)
+            {
+                startDuplicates(renderer, data);
+            }
+            else if(data->compare_view)
+            {
+                startCompareView(renderer, data, getCompareRootPath(false), getCompareRootPath(true), getCompareContent());
+            }
+            break;
+        case SDLK_BACKSPACE:
+            if(data->treemap_view && data->treemap_root != NULL && data->treemap_root->parent != NULL)
+            {
+                data->treemap_root = data->treemap_root->parent;
+                updateTreemap(renderer, data);
+            }
+            break;
+        // Ctrl+H shows or hides dotfiles, Ctrl+I turns ignore rules on and off
+        case SDLK_h:
+        case SDLK_i:
+            if(ctrl)
+            {
+                bool show_hidden = getShowHidden() != (key == SDLK_h);
+                bool use_rules = getUseIgnoreRules() != (key == SDLK_i);
+                setIgnoreOptions(show_hidden, use_rules);
+                refreshAllDirectories(renderer, data);
+                setStatus(renderer, data, std::string(show_hidden ? "Hidden files shown" : "Hidden files hidden") +
+                                          (use_rules ? ", ignore rules on" : ", ignore rules off"));
+            }
+            break;
+        // Rename the single selected file
+        case SDLK_F2:
+        {
+            std::vector<File*> selected = getSelectedFiles(data);
+            if(selected.size() != 1) break;
+            data->renaming = true;
+            data->rename_source = selected[0]->path;
+            // Rows in the duplicate list are named by their path below the scanned directory
+            data->rename_text = selected[0]->path.substr(selected[0]->path.find_last_of('/') + 1);
+            SDL_StartTextInput();
+            updatePathText(renderer, data, "Rename to: " + data->rename_text + "_");
+            break;
+        }
+    }
+}
+
+/** Handle typed text, used for the rename prompt
+ */
+void textHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
+{
+    if(!data->renaming) return;
+    data->rename_text += event->text.text;
+    updatePathText(renderer, data, "Rename to: " + data->rename_text + "_");
+}
+
+
+// ─── SELECTION ──────────────────────────────────────────────────────────────────
+
+
+/** Gets every selected file, in the order they appear on screen
+ * @param data AppData
+ * @return The selected files
+ */
+std::vector<File*> getSelectedFiles(AppData* data)
+{
+    std::vector<File*> selected;
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        if(data->files[i]->is_selected) selected.push_back(data->files[i]);
+    }
+    return selected;
+}
+
+/** Deselects every file
+ * @param data AppData
+ */
+void clearSelection(AppData* data)
+{
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        data->files[i]->is_selected = false;
+    }
+}
+
+
+// ─── ROWS ───────────────────────────────────────────────────────────────────────
+
+
+/** Finds the row showing a path
+ * @param data AppData
+ * @param path Path to look for
+ * @return Index into data->files, or -1 if the path isn't shown
+ */
+int findFileRow(AppData* data, std::string path)
+{
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        if(data->files[i]->path == path) return i;
+    }
+    return -1;
+}
+
+/** Removes a row, along with its expanded contents, and frees it
+ * @param data AppData
+ * @param index Index of the row in data->files
+ */
+void removeFileRow(AppData* data, int index)
+{
+    File* file = data->files[index];
+    if(file->is_expanded) collapseFiles(data, file, file->sub_files, index);
+    if(file->is_virtual) freeItemVector(&file->sub_files);
+
+    // Rows below depth 0 are also owned by their parent's sub_files
+    for(int i = index - 1; i >= 0 && file->depth > 0; i--)
+    {
+        if(data->files[i]->depth == file->depth - 1)
+        {
+            std::vector<File*>* siblings = &data->files[i]->sub_files;
+            siblings->erase(std::remove(siblings->begin(), siblings->end(), file), siblings->end());
+            break;
+        }
+    }
+
+    data->files.erase(data->files.begin() + index);
+    data->num_files--;
+    forgetFileStat(file);
+    delete file;
+}
+
+/** Removes rows, along with their expanded contents, and frees them
+ * Done in one pass over the rows however many are removed, so a refresh
+ * or an operation that drops many files from a large directory stays linear.
+ * @param data AppData
+ * @param files Rows to remove, each of them must be in data->files
+ */
+void removeFileRows(AppData* data, const std::vector<File*>& files)
+{
+    if(files.empty()) return;
+    std::unordered_set<File*> removed(files.begin(), files.end());
+    std::unordered_set<File*> parents;
+    // The last row seen at each depth, the parent of the rows one deeper
+    std::vector<File*> ancestors;
+    std::vector<File*> rows;
+    rows.reserve(data->files.size());
+    int i = 0;
+    while(i < data->files.size())
+    {
+        File* file = data->files[i];
+        ancestors.resize(file->depth);
+        if(!removed.count(file))
+        {
+            ancestors.push_back(file);
+            rows.push_back(file);
+            i++;
+            continue;
+        }
+        // Rows below depth 0 are also owned by their parent's sub_files
+        if(file->depth > 0) parents.insert(ancestors[file->depth - 1]);
+        // Expanded contents go with the row, they are owned by its sub_files
+        for(i++; i < data->files.size() && data->files[i]->depth > file->depth; i++);
+        freeFileRow(file);
+    }
+
+    for(std::unordered_set<File*>::iterator it = parents.begin(); it != parents.end(); it++)
+    {
+        std::vector<File*>* siblings = &(*it)->sub_files;
+        siblings->erase(std::remove_if(siblings->begin(), siblings->end(), [&](File* file) { return removed.count(file) > 0; }), siblings->end());
+    }
+    data->files.swap(rows);
+    data->num_files = data->files.size();
+}
+
+/** Frees a row that was taken out of data->files and everything it owns
+ * Expanded rows own their contents, virtual rows own them even when collapsed.
+ */
+void freeFileRow(File* file)
+{
+    if(file->is_expanded || file->is_virtual)
+    {
+        for(int i = 0; i < file->sub_files.size(); i++) freeFileRow(file->sub_files[i]);
+    }
+    forgetFileStat(file);
+    delete file;
+}
+
+/** Inserts new rows under their parents, keeping directories first and names in order
+ * The new files are grouped by directory so each sibling list is ranked and
+ * sorted once, then the rows are rebuilt in one pass, like duplicatesHandler
+ * does. Files whose directory isn't currently shown are freed instead.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param files Files to insert, their depth is set from the parent
+ * @return Number of rows inserted
+ */
+int insertFileRows(SDL_Renderer* renderer, AppData* data, const std::vector<File*>& files)
+{
+    if(files.empty()) return 0;
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    std::vector<File*> top_level;
+    std::unordered_map<std::string, File*> expanded;
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        if(data->files[i]->depth == 0) top_level.push_back(data->files[i]);
+        if(data->files[i]->is_expanded) expanded[data->files[i]->path] = data->files[i];
+    }
+
+    int inserted = 0;
+    bool top_level_changed = false;
+    std::vector<File*> changed;
+    for(int i = 0; i < files.size(); i++)
+    {
+        File* file = files[i];
+        std::string parent = parentPath(file->path);
+        if(parent == current)
+        {
+            file->depth = 0;
+            top_level.push_back(file);
+            top_level_changed = true;
+            inserted++;
+            continue;
+        }
+        std::unordered_map<std::string, File*>::iterator it = expanded.find(parent);
+        if(it == expanded.end())
+        {
+            delete file;
+            continue;
+        }
+        file->depth = it->second->depth + 1;
+        if(std::find(changed.begin(), changed.end(), it->second) == changed.end()) changed.push_back(it->second);
+        it->second->sub_files.push_back(file);
+        inserted++;
+    }
+
+    for(int i = 0; i < changed.size(); i++)
+    {
+        rankFileNames(&changed[i]->sub_files);
+        sortFileVector(&changed[i]->sub_files, data->sort_column, data->sort_descending);
+    }
+    if(top_level_changed)
+    {
+        rankFileNames(&top_level);
+        sortFileVector(&top_level, data->sort_column, data->sort_descending);
+    }
+
+    std::vector<File*> rows;
+    rows.reserve(data->files.size() + inserted);
+    flattenFiles(&rows, top_level);
+    data->files.swap(rows);
+    data->num_files = data->files.size();
+    return inserted;
+}
+
+/** Brings one listed directory up to date with the disk
+ * Rows that disappeared are removed and new entries are inserted in sort
+ * order; rows that are still there keep their expansion and selection and
+ * take the metadata of the new listing.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param dirpath The current directory or an expanded one, others are ignored
+ */
+void refreshDirectory(SDL_Renderer* renderer, AppData* data, std::string dirpath)
+{
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    std::vector<File*> existing;
+    int depth;
+    if(dirpath == current)
+    {
+        depth = 0;
+        for(int i = 0; i < data->files.size(); i++)
+        {
+            if(data->files[i]->depth == 0) existing.push_back(data->files[i]);
+        }
+    }
+    else
+    {
+        int index = findFileRow(data, dirpath);
+        // Archives are only read again once they change on disk and are expanded anew
+        if(index < 0 || !data->files[index]->is_expanded || data->files[index]->archive != "") return;
+        depth = data->files[index]->depth + 1;
+        existing = data->files[index]->sub_files;
+    }
+
+    std::vector<File*> listing = getItemsInDirectory(dirpath, depth, data->lazy_stat);
+    std::unordered_map<std::string, File*> listed;
+    for(int i = 0; i < listing.size(); i++) listed[listing[i]->name] = listing[i];
+
+    // Entries of the listing that already have a row
+    std::unordered_set<File*> kept;
+    std::vector<File*> removed;
+    for(int i = 0; i < existing.size(); i++)
+    {
+        std::unordered_map<std::string, File*>::iterator it = listed.find(existing[i]->name);
+        // A file replaced by a directory of the same name, or the reverse, gets a new row
+        if(it != listed.end() && it->second->is_dir == existing[i]->is_dir)
+        {
+            refreshFileStat(existing[i], it->second);
+            kept.insert(it->second);
+        }
+        else if(existing[i]->name != "..") removed.push_back(existing[i]);
+    }
+    removeFileRows(data, removed);
+
+    std::vector<File*> added;
+    for(int i = 0; i < listing.size(); i++)
+    {
+        File* file = listing[i];
+        // expanded listings don't show ".."
+        if((file->name == ".." && depth > 0) || kept.count(file))
+        {
+            delete file;
+            continue;
+        }
+        added.push_back(file);
+    }
+    insertFileRows(renderer, data, added);
+
+    updateScrollbarRatio(data);
+    if(data->scroll_offset > data->files_height - data->page_height) data->scroll_offset = data->files_height - data->page_height;
+    if(data->scroll_offset < 0) data->scroll_offset = 0;
+}
+
+/** Gives a row the metadata of a fresh listing of the same entry
+ * A lazy listing carries no metadata, the row is then stat'ed again once it is near the view.
+ * @param file Row to update
+ * @param listed The entry as it was just listed
+ */
+void refreshFileStat(File* file, File* listed)
+{
+    if(!listed->has_stat)
+    {
+        file->has_stat = false;
+        return;
+    }
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+    info.st_mode = listed->mode;
+    info.st_size = listed->size_bytes;
+    info.st_mtime = listed->mtime;
+    applyFileStat(file, &info);
+}
+
+/** Re-lists the current directory and every expanded one, after the listing filters changed
+ */
+void refreshAllDirectories(SDL_Renderer* renderer, AppData* data)
+{
+    if(!showsDirectoryListing(data)) return;
+    std::vector<std::string> paths(1, (data->PathText == "") ? "/" : data->PathText);
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        if(data->files[i]->is_expanded) paths.push_back(data->files[i]->path);
+    }
+    // Parents go first, so directories that disappear take their expanded children with them
+    for(int i = 0; i < paths.size(); i++) refreshDirectory(renderer, data, paths[i]);
+}
+
+/** @return False while the rows are duplicate groups or a comparison rather than the current directory
+ */
+bool showsDirectoryListing(AppData* data)
+{
+    return !data->dupes_view && !data->compare_view;
+}
+
+
+// ─── ARCHIVES ───────────────────────────────────────────────────────────────────
+
+
+/** Lists one level of an archive, for an archive row or a directory inside one
+ * The first expansion indexes the archive in the background and lists nothing,
+ * archiveHandler fills the row in once the index is ready.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param dir Archive row, or a directory row inside an archive
+ * @return Rows one level deeper than dir
+ */
+std::vector<File*> getItemsInArchive(SDL_Renderer* renderer, AppData* data, File* dir)
+{
+    std::vector<File*> items;
+    std::string archive_name = dir->archive.substr(dir->archive.find_last_of('/') + 1);
+    std::shared_ptr<const ArchiveIndex> index = getArchiveIndex(dir->archive);
+    if(index == NULL)
+    {
+        setStatus(renderer, data, "Indexing " + archive_name + "...");
+        return items;
+    }
+    // Whatever was read before a damaged part of the archive is still listed
+    if(index->error != "") setStatus(renderer, data, archive_name + ": " + index->error);
+
+    std::string inner_path = (dir->path == dir->archive) ? "" : dir->path.substr(dir->archive.size() + 1);
+    const ArchiveEntry* entry = findArchiveEntry(index.get(), inner_path);
+    if(entry == NULL) return items;
+    for(int i = 0; i < entry->children.size(); i++)
+    {
+        items.push_back(createArchiveRow(dir, &index->entries[entry->children[i]]));
+    }
+    rankFileNames(&items);
+    return items;
+}
+
+/** Creates the row of an archive member, with its metadata taken from the index
+ * @param dir Row of the directory holding the member
+ * @param entry The member
+ * @return The new file entry
+ */
+File* createArchiveRow(File* dir, const ArchiveEntry* entry)
+{
+    File* row = createLazyFileEntry(dir->path, entry->name, dir->depth + 1, entry->is_dir);
+
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+    info.st_size = entry->size;
+    info.st_mtime = entry->mtime;
+    info.st_mode = entry->mode;
+    applyFileStat(row, &info);
+
+    // Archives nested in an archive are shown as plain files
+    row->archive = dir->archive;
+    return row;
+}
+
+/** Lists the archive rows that were expanded while their index was still being built
+ */
+void archiveHandler(SDL_Renderer* renderer, AppData* data)
+{
+    if(data->StatusText.compare(0, 9, "Indexing ") == 0) setStatus(renderer, data, "");
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        File* file = data->files[i];
+        if(file->archive == "" || !file->is_expanded || !file->sub_files.empty()) continue;
+        file->sub_files = getItemsInArchive(renderer, data, file);
+        sortFileVector(&file->sub_files, data->sort_column, data->sort_descending);
+        data->files.insert(data->files.begin() + i + 1, file->sub_files.begin(), file->sub_files.end());
+        data->num_files += file->sub_files.size();
+    }
+    updateScrollbarRatio(data);
+}
+
+
+// ─── FILE OPERATIONS ────────────────────────────────────────────────────────────
+
+
+/** Applies finished operations to the rows and refreshes the progress in the status bar
+ * Only the rows that were affected are touched, the directory isn't rescanned.
+ */
+void fileOpsHandler(SDL_Renderer* renderer, AppData* data)
+{
+    FileOpResult result;
+    bool changed = false;
+    while(popFileOpResult(&result))
+    {
+        std::unordered_map<std::string, File*> rows;
+        for(int i = 0; i < data->files.size(); i++) rows[data->files[i]->path] = data->files[i];
+
+        std::vector<File*> removed;
+        for(int i = 0; i < result.removed.size(); i++)
+        {
+            std::unordered_map<std::string, File*>::iterator it = rows.find(result.removed[i]);
+            if(it != rows.end())
+            {
+                removed.push_back(it->second);
+                rows.erase(it);
+            }
+            else if(data->dupes_view) forgetDuplicateMember(data, result.removed[i]);
+        }
+        // New files only show up in the duplicate list or the comparison when it is run again
+        std::vector<File*> created;
+        for(int i = 0; i < result.created.size() && showsDirectoryListing(data); i++)
+        {
+            std::unordered_map<std::string, File*>::iterator it = rows.find(result.created[i]);
+            if(it != rows.end())
+            {
+                removed.push_back(it->second);
+                rows.erase(it);
+            }
+            File* file = getFileInfo(result.created[i], 0);
+            if(file != NULL) created.push_back(file);
+        }
+        removeFileRows(data, removed);
+        insertFileRows(renderer, data, created);
+        if(data->dupes_view) pruneDuplicateGroups(data);
+        setStatus(renderer, data, getResultText(&result));
+        changed = true;
+    }
+
+    if(changed)
+    {
+        updateScrollbarRatio(data);
+        if(data->scroll_offset > data->files_height - data->page_height) data->scroll_offset = data->files_height - data->page_height;
+        if(data->scroll_offset < 0) data->scroll_offset = 0;
+    }
+
+    FileOpProgress progress;
+    if(getFileOpProgress(&progress))
+    {
+        setStatus(renderer, data, getProgressText(&progress));
+    }
+}
+
+/** Queues an operation on every selected file
+ */
+void queueSelectionOp(SDL_Renderer* renderer, AppData* data, OpKind kind)
+{
+    std::vector<File*> selected = getSelectedFiles(data);
+    FileOp op;
+    op.kind = kind;
+    for(int i = 0; i < selected.size(); i++)
+    {
+        op.sources.push_back(selected[i]->path);
+    }
+    if(op.sources.empty()) return;
+    queueFileOp(op);
+    clearSelection(data);
+}
+
+/** Formats the status bar line for a running operation
+ */
+std::string getProgressText(FileOpProgress* progress)
+{
+    std::string text = opKindToString(progress->kind) + " " + std::to_string(progress->files_done) + "/" + std::to_string(progress->files_total) + " files";
+    if(progress->bytes_total > 0)
+    {
+        text += ", " + parseSize(progress->bytes_done) + " of " + parseSize(progress->bytes_total);
+    }
+    if(progress->seconds > 0.5)
+    {
+        text += " (" + parseSize(progress->bytes_done / progress->seconds) + "/s)";
+    }
+    if(progress->queued > 0)
+    {
+        text += " +" + std::to_string(progress->queued) + " queued";
+    }
+    return text + " - Esc to cancel";
+}
+
+/** Formats the status bar line for a finished operation
+ */
+std::string getResultText(FileOpResult* result)
+{
+    std::string text = opKindToString(result->kind);
+    if(result->cancelled) text += " cancelled after ";
+    else text += " done: ";
+    text += std::to_string(result->files_done) + " files";
+    if(result->bytes_done > 0)
+    {
+        text += ", " + parseSize(result->bytes_done);
+    }
+    char seconds[32];
+    snprintf(seconds, sizeof(seconds), " in %.1fs", result->seconds);
+    text += seconds;
+    if(result->errors > 0)
+    {
+        text += " - " + std::to_string(result->errors) + " error(s), " + result->first_error;
+    }
+    return text;
+}
+
+
+// ─── TREEMAP ────────────────────────────────────────────────────────────────────
+
+
+/** Switches between the file list and the treemap of the current directory
+ * A walk of the same directory is kept, so switching back and forth is instant.
+ */
+void toggleTreemap(SDL_Renderer* renderer, AppData* data)
+{
+    data->treemap_view = !data->treemap_view;
+    if(!data->treemap_view)
+    {
+        updatePathText(renderer, data, data->PathText);
+        setStatus(renderer, data, "");
+        return;
+    }
+
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    if(getTreemapRoot() == NULL || getTreemapRootPath() != current)
+    {
+        startTreemapWalk(current, data->treemap_event);
+    }
+    data->treemap_root = getTreemapRoot();
+    updateTreemap(renderer, data);
+}
+
+/** Lays the treemap out again from the walk's current totals
+ */
+void updateTreemap(SDL_Renderer* renderer, AppData* data)
+{
+    layoutTreemap(data->treemap_root, data->Treemap_area, &data->treemap_rects);
+    if(data->treemap_root != NULL) updatePathText(renderer, data, getTreeNodePath(data->treemap_root));
+
+    TreemapProgress progress;
+    if(getTreemapProgress(&progress)) setStatus(renderer, data, getTreemapStatusText(&progress));
+}
+
+/** Picks up totals reported by the size walk
+ */
+void treemapHandler(SDL_Renderer* renderer, AppData* data)
+{
+    if(data->treemap_view) updateTreemap(renderer, data);
+}
+
+/** Left click zooms into the directory under the mouse, right click zooms out
+ */
+void treemapClickHandler(SDL_Event* event, SDL_Renderer* renderer, AppData* data)
+{
+    if(data->treemap_root == NULL) return;
+    TreeNode* target = NULL;
+    if(event->button.button == SDL_BUTTON_RIGHT) target = data->treemap_root->parent;
+    else target = findTreemapDirectory(data->treemap_rects, event->button.x, event->button.y);
+
+    if(target == NULL || target == data->treemap_root) return;
+    data->treemap_root = target;
+    updateTreemap(renderer, data);
+}
+
+/** Queues the treemap rectangles: directories as framed panels with a name strip, files in their Type's color
+ */
+void renderTreemap(SDL_Renderer* renderer, AppData* data)
+{
+    const SDL_Color text_color = {0, 0, 0, 255};
+    batchFill(data->Treemap_area, TREEMAP_DIRECTORY_COLOR);
+    if(data->treemap_root == NULL) return;
+    batchText(parseSize(data->treemap_root->size), data->Treemap_area.x + 3, data->Treemap_area.y - 1, text_color);
+
+    for(int i = 0; i < data->treemap_rects.size(); i++)
+    {
+        const TreemapRect* rect = &data->treemap_rects[i];
+        TreeNode* node = rect->node;
+        batchFill(rect->rect, TREEMAP_BORDER_COLOR);
+        if(rect->rect.w <= 2 || rect->rect.h <= 2) continue;
+
+        SDL_Rect inner = {rect->rect.x + 1, rect->rect.y + 1, rect->rect.w - 2, rect->rect.h - 2};
+        batchFill(inner, node->is_dir ? TREEMAP_DIRECTORY_COLOR : TREEMAP_TYPE_COLORS[(int) node->type]);
+
+        if(rect->rect.w < TREEMAP_LABEL_MIN_SIZE || rect->rect.h < TREEMAP_LABEL_MIN_SIZE) continue;
+        // The longest label that fits: name and size, then just the name
+        std::string label = node->name + "  " + parseSize(node->size);
+        if(measureText(label) > inner.w - 4) label = node->name;
+        if(measureText(label) <= inner.w - 4) batchText(label, inner.x + 2, inner.y - 2, text_color);
+    }
+}
+
+/** Describes the size walk for the status bar
+ */
+std::string getTreemapStatusText(TreemapProgress* progress)
+{
+    std::string text = progress->done ? "Measured " : "Measuring... ";
+    text += std::to_string(progress->files) + " files in " + std::to_string(progress->dirs) + " directories, ";
+    text += parseSize(progress->bytes);
+    text += "  (click to zoom in, right click to zoom out)";
+    return text;
+}
+
+
+// ─── DUPLICATES ─────────────────────────────────────────────────────────────────
+
+
+/** Switches between the file list and the duplicate files below the current directory
+ */
+void toggleDuplicates(SDL_Renderer* renderer, AppData* data)
+{
+    data->dupes_view = !data->dupes_view;
+    if(data->dupes_view)
+    {
+        // Groups wasting the most space first, the list gets its own order back afterwards
+        data->dupes_saved_column = data->sort_column;
+        data->dupes_saved_descending = data->sort_descending;
+        data->sort_column = SortColumn::SIZE;
+        data->sort_descending = true;
+        updateColumnHeaders(renderer, data);
+        startDuplicates(renderer, data);
+        return;
+    }
+
+    stopDuplicateScan();
+    data->sort_column = data->dupes_saved_column;
+    data->sort_descending = data->dupes_saved_descending;
+    updateColumnHeaders(renderer, data);
+
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    std::vector<File*> newFiles = getItemsInDirectory(current, 0, data->lazy_stat);
+    sortFileVector(&newFiles, data->sort_column, data->sort_descending);
+    setFiles(renderer, data, newFiles);
+    updatePathText(renderer, data, data->PathText);
+    setStatus(renderer, data, "");
+    data->scroll_offset = 0;
+    updateScrollbarRatio(data);
+}
+
+/** Empties the list and scans the current directory for duplicates, groups are added as they are found
+ */
+void startDuplicates(SDL_Renderer* renderer, AppData* data)
+{
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    data->delete_pending = false;
+    setFiles(renderer, data, std::vector<File*>());
+    data->scroll_offset = 0;
+    updateScrollbarRatio(data);
+
+    startDuplicateScan(current, data->dupes_event);
+    updatePathText(renderer, data, "Duplicates in " + current);
+    DuplicateProgress progress;
+    if(getDuplicateProgress(&progress)) setStatus(renderer, data, getDuplicatesStatusText(&progress));
+}
+
+/** Adds the groups found since the last event and refreshes the progress in the status bar
+ */
+void duplicatesHandler(SDL_Renderer* renderer, AppData* data)
+{
+    if(!data->dupes_view) return;
+
+    std::vector<File*> added;
+    DuplicateGroup group;
+    while(popDuplicateGroup(&group))
+    {
+        File* row = createDuplicateRow(data, group);
+        if(row != NULL) added.push_back(row);
+    }
+
+    // One sort per event rather than one insert per group, a scan can find thousands
+    if(!added.empty())
+    {
+        std::vector<File*> top_level = added;
+        for(int i = 0; i < data->files.size(); i++)
+        {
+            if(data->files[i]->depth == 0) top_level.push_back(data->files[i]);
+        }
+        rankFileNames(&top_level);
+        sortFileVector(&top_level, data->sort_column, data->sort_descending);
+
+        std::vector<File*> rows;
+        rows.reserve(data->files.size() + added.size());
+        flattenFiles(&rows, top_level);
+        data->files.swap(rows);
+        data->num_files = data->files.size();
+        updateScrollbarRatio(data);
+    }
+
+    DuplicateProgress progress;
+    if(getDuplicateProgress(&progress)) setStatus(renderer, data, getDuplicatesStatusText(&progress));
+}
+
+/** Builds the row for a group of identical files, with a row for each of its paths below it
+ * The group sorts by the space its extra copies take; its paths are shown relative to the
+ * scanned directory and stay with the row while it is collapsed.
+ * @param data AppData
+ * @param group Group reported by the scan
+ * @return The collapsed group row, or NULL if fewer than two of its paths are still there
+ */
+File* createDuplicateRow(AppData* data, const DuplicateGroup& group)
+{
+    std::string root = (data->PathText == "") ? "/" : data->PathText;
+    size_t prefix = joinPath(root, "").size();
+
+    std::vector<File*> members;
+    for(int i = 0; i < group.copies.size(); i++)
+    {
+        for(int j = 0; j < group.copies[i].size(); j++)
+        {
+            const std::string& path = group.copies[i][j];
+            struct stat info;
+            if(lstat(path.c_str(), &info) != 0) continue;
+
+            File* file = createLazyFileEntry(root, path.substr(prefix), 1, false);
+            size_t dot = path.find_last_of('.');
+            file->extension = (dot == std::string::npos || dot < path.find_last_of('/')) ? "" : path.substr(dot + 1);
+            applyFileStat(file, &info);
+            // Further names of the same inode take no space of their own
+            if(j > 0) file->name += "  (hard link)";
+            members.push_back(file);
+        }
+    }
+    if(members.size() < 2)
+    {
+        freeItemVector(&members);
+        return NULL;
+    }
+    rankFileNames(&members);
+
+    std::string path = group.copies[0][0];
+    File* row = createLazyFileEntry(root, path.substr(path.find_last_of('/') + 1), 0, true);
+    uint64_t wasted = group.size * (group.copies.size() - 1);
+    row->is_virtual = true;
+    row->has_stat = true;
+    row->path = "";
+    row->type = parseType(false, false, row->extension);
+    row->size = parseSize(wasted);
+    row->modified = std::to_string(group.copies.size()) + " copies";
+    row->permissions = parseSize(group.size) + " each";
+    row->size_bytes = wasted;
+    row->sub_files = members;
+    return row;
+}
+
+/** Drops a path from the collapsed groups, expanded ones show it as a row of their own
+ */
+void forgetDuplicateMember(AppData* data, std::string path)
+{
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        File* row = data->files[i];
+        if(!row->is_virtual || row->is_expanded) continue;
+        for(int j = 0; j < row->sub_files.size(); j++)
+        {
+            if(row->sub_files[j]->path != path) continue;
+            forgetFileStat(row->sub_files[j]);
+            delete row->sub_files[j];
+            row->sub_files.erase(row->sub_files.begin() + j);
+            return;
+        }
+    }
+}
+
+/** Removes the groups that deleting or moving files left with a single path
+ */
+void pruneDuplicateGroups(AppData* data)
+{
+    // Backwards, so removing a group and its expanded rows doesn't shift the rows still to check
+    for(int i = (int) data->files.size() - 1; i >= 0; i--)
+    {
+        if(data->files[i]->is_virtual && data->files[i]->sub_files.size() < 2) removeFileRow(data, i);
+    }
+}
+
+/** Describes the duplicate scan for the status bar
+ */
+std::string getDuplicatesStatusText(DuplicateProgress* progress)
+{
+    if(progress->stage == DupeStage::LISTING)
+    {
+        return "Listing... " + std::to_string(progress->files) + " files, " + parseSize(progress->bytes_total);
+    }
+
+    std::string text;
+    if(progress->stage == DupeStage::PARTIAL_HASH) text = "Comparing ends... ";
+    else if(progress->stage == DupeStage::FULL_HASH) text = "Hashing... ";
+    else text = "Done: ";
+    text += std::to_string(progress->groups) + " groups, " + parseSize(progress->bytes_wasted) + " in extra copies";
+    text += " - hashed " + parseSize(progress->bytes_hashed) + ", skipped " + parseSize(progress->bytes_skipped);
+    text += " of " + parseSize(progress->bytes_total);
+    return text;
+}
+
+
+// ─── COMPARE ────────────────────────────────────────────────────────────────────
+
+
+/** Replaces the list with the merged tree of two directories, filled in as they are walked
+ * The new tree becomes the current directory, so opening files, pasting and
+ * leaving the view all happen there.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param left The old tree
+ * @param right The new tree
+ * @param check_content Compare the bytes of files that match in size instead of their mtimes
+ */
+void startCompareView(SDL_Renderer* renderer, AppData* data, std::string left, std::string right, bool check_content)
+{
+    // The rows point into the merged tree, they have to go before it is replaced
+    setFiles(renderer, data, std::vector<File*>());
+    startCompare(left, right, check_content, data->compare_event);
+    if(getCompareRoot() == NULL)
+    {
+        data->compare_view = true;
+        leaveCompareView(renderer, data);
+        setStatus(renderer, data, "Can't compare " + left + " with " + right);
+        return;
+    }
+
+    data->compare_view = true;
+    data->delete_pending = false;
+    setPath(data, right);
+    data->scroll_offset = 0;
+    updatePathText(renderer, data, "Compare " + left + " -> " + right);
+    compareHandler(renderer, data);
+}
+
+/** Goes back to the list of the current directory
+ */
+void leaveCompareView(SDL_Renderer* renderer, AppData* data)
+{
+    data->compare_view = false;
+    std::string current = (data->PathText == "") ? "/" : data->PathText;
+    std::vector<File*> newFiles = getItemsInDirectory(current, 0, data->lazy_stat);
+    sortFileVector(&newFiles, data->sort_column, data->sort_descending);
+    setFiles(renderer, data, newFiles);
+    stopCompare();
+
+    updatePathText(renderer, data, data->PathText);
+    setStatus(renderer, data, "");
+    data->scroll_offset = 0;
+    updateScrollbarRatio(data);
+}
+
+/** Picks up the part of the merged tree walked since the last event
+ */
+void compareHandler(SDL_Renderer* renderer, AppData* data)
+{
+    if(!data->compare_view) return;
+    rebuildCompareRows(renderer, data);
+
+    CompareProgress progress;
+    if(getCompareProgress(&progress)) setStatus(renderer, data, getCompareStatusText(&progress));
+}
+
+/** Builds the rows again from the merged tree, keeping what was expanded, selected and scrolled to
+ * Only the expanded part of the tree becomes rows, however large the trees are.
+ */
+void rebuildCompareRows(SDL_Renderer* renderer, AppData* data)
+{
+    std::unordered_set<CompareNode*> expanded;
+    std::unordered_set<CompareNode*> selected;
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        File* row = data->files[i];
+        if(row->compare_node == NULL) continue;
+        if(row->is_expanded) expanded.insert(row->compare_node);
+        if(row->is_selected) selected.insert(row->compare_node);
+    }
+
+    std::vector<File*> top_level;
+    CompareNode* root = getCompareRoot();
+    if(root != NULL && root->scanned.load(std::memory_order_acquire))
+    {
+        top_level = createCompareRows(root, 0, expanded, selected);
+    }
+    sortExpandedFiles(&top_level, data->sort_column, data->sort_descending);
+
+    freeRows(data);
+    flattenFiles(&data->files, top_level);
+    data->num_files = data->files.size();
+    updateScrollbarRatio(data);
+    if(data->scroll_offset > data->files_height - data->page_height) data->scroll_offset = data->files_height - data->page_height;
+    if(data->scroll_offset < 0) data->scroll_offset = 0;
+}
+
+/** Creates the rows for the entries of a merged directory
+ * @param node Directory of the merged tree, already scanned
+ * @param depth How many expanded directories deep the rows are shown
+ * @param expanded Entries whose rows are created expanded, with their own rows below them
+ * @param selected Entries whose rows are created selected
+ * @return The rows, ranked by name
+ */
+std::vector<File*> createCompareRows(CompareNode* node, int depth, const std::unordered_set<CompareNode*>& expanded, const std::unordered_set<CompareNode*>& selected)
+{
+    std::vector<File*> rows;
+    for(int i = 0; i < node->children.size(); i++)
+    {
+        CompareNode* child = node->children[i];
+        File* row = createCompareRow(child, depth);
+        row->is_selected = (selected.count(child) > 0);
+        // A directory that isn't walked yet stays expanded and fills in on a later rebuild
+        if(expanded.count(child) > 0)
+        {
+            row->is_expanded = true;
+            if(child->scanned.load(std::memory_order_acquire)) row->sub_files = createCompareRows(child, depth + 1, expanded, selected);
+        }
+        rows.push_back(row);
+    }
+    rankFileNames(&rows);
+    return rows;
+}
+
+/** Creates the row for one entry of the merged tree, with the metadata of its new side
+ * Changed entries have why they changed added to their name.
+ * @param node Entry of the merged tree
+ * @param depth How many expanded directories deep the row is shown
+ * @return The new row
+ */
+File* createCompareRow(CompareNode* node, int depth)
+{
+    std::string path = getCompareNodePath(node, node->diff != DiffKind::REMOVED);
+    File* row = createLazyFileEntry(parentPath(path), node->name, depth, node->is_dir);
+
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+    info.st_size = node->size;
+    info.st_mtime = node->mtime;
+    info.st_mode = node->mode;
+    applyFileStat(row, &info);
+
+    row->compare_node = node;
+    row->diff = getCompareNodeDiff(node);
+    if(row->diff == DiffKind::CHANGED)
+    {
+        if(node->is_dir) row->name += "  (" + std::to_string(node->changes.load()) + " differences)";
+        else row->name += "  (" + getDiffReasonText(node->reasons) + ")";
+    }
+    return row;
+}
+
+/** Describes the comparison for the status bar
+ */
+std::string getCompareStatusText(CompareProgress* progress)
+{
+    std::string text = progress->done ? "Compared " : "Comparing... ";
+    text += std::to_string(progress->entries) + " entries: " + std::to_string(progress->added) + " added, ";
+    text += std::to_string(progress->removed) + " removed, " + std::to_string(progress->changed) + " changed";
+    if(progress->checks_pending > 0)
+    {
+        text += " - checking " + std::to_string(progress->checks_pending) + " files";
+    }
+    if(progress->bytes_compared > 0)
+    {
+        text += ", " + parseSize(progress->bytes_compared) + " read";
+    }
+    return text;
+}
+
+
+// ─── SORTING ────────────────────────────────────────────────────────────────────
+
+
+// A row's precomputed keys for the active column, 16 bytes so the radix passes stay in cache
+typedef struct SortEntry {
+    uint64_t key;
+    // group in the top 2 bits (".." = 0, directories = 1, files = 2), name_rank below
+    uint32_t tie;
+    uint32_t index;
+} SortEntry;
+
+#define SORT_RANK_MASK 0x3FFFFFFF
+
+/** Gets the numeric key of a file for a column, ordered so smaller sorts first
+ */
+static uint64_t getSortKey(File* file, SortColumn column)
+{
+    switch(column)
+    {
+        case SortColumn::TYPE:
+            return (uint64_t) file->type;
+        case SortColumn::NAME:
+            return file->name_rank;
+        case SortColumn::MODIFIED:
+            // flip the sign bit so negative times order before positive ones
+            return (uint64_t) file->mtime ^ (1ULL << 63);
+        case SortColumn::SIZE:
+            return file->size_bytes;
+        case SortColumn::PERMISSIONS:
+            return file->mode & 07777;
+    }
+    return 0;
+}
+
+static bool sortEntryBefore(const SortEntry& a, const SortEntry& b)
+{
+    if((a.tie >> 30) != (b.tie >> 30)) return (a.tie >> 30) < (b.tie >> 30);
+    if(a.key != b.key) return a.key < b.key;
+    // ties on the column go by name
+    return (a.tie & SORT_RANK_MASK) < (b.tie & SORT_RANK_MASK);
+}
+
+static SortEntry makeSortEntry(File* file, uint32_t index, SortColumn column, bool descending)
+{
+    SortEntry entry;
+    entry.key = getSortKey(file, column);
+    if(descending) entry.key = ~entry.key;
+    entry.tie = ((uint32_t) file->sort_group << 30) | (file->name_rank & SORT_RANK_MASK);
+    entry.index = index;
+    return entry;
+}
+
+// Byte `pass` of an entry's full order: 4 bytes of name_rank, 8 of key, then the group
+static inline unsigned radixByte(const SortEntry& entry, int pass)
+{
+    if(pass < 4) return ((entry.tie & SORT_RANK_MASK) >> (pass * 8)) & 0xFF;
+    if(pass < 12) return (entry.key >> ((pass - 4) * 8)) & 0xFF;
+    return entry.tie >> 30;
+}
+
+/** Sorts entries by (group, key, name_rank) with a least-significant-byte radix sort
+ * Equivalent to a stable sort with sortEntryBefore, but linear in the number of
+ * rows. Passes where every entry has the same byte, like the high bytes of most
+ * sizes, are skipped.
+ */
+static void radixSortEntries(std::vector<SortEntry>* entries)
+{
+    const int passes = 13;
+    size_t n = entries->size();
+    std::vector<size_t> counts(passes * 256, 0);
+    for(size_t i = 0; i < n; i++)
+    {
+        const SortEntry& entry = (*entries)[i];
+        uint32_t rank = entry.tie & SORT_RANK_MASK;
+        for(int pass = 0; pass < 4; pass++) counts[pass * 256 + ((rank >> (pass * 8)) & 0xFF)]++;
+        for(int pass = 4; pass < 12; pass++) counts[pass * 256 + ((entry.key >> ((pass - 4) * 8)) & 0xFF)]++;
+        counts[12 * 256 + (entry.tie >> 30)]++;
+    }
+
+    std::vector<SortEntry> buffer(n);
+    for(int pass = 0; pass < passes; pass++)
+    {
+        size_t* count = &counts[pass * 256];
+        if(count[radixByte((*entries)[0], pass)] == n) continue;
+
+        size_t offset = 0;
+        for(int b = 0; b < 256; b++)
+        {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            const SortEntry& entry = (*entries)[i];
+            buffer[count[radixByte(entry, pass)]++] = entry;
+        }
+        entries->swap(buffer);
+    }
+}
+
+/** Stores each file's position in name order as its name_rank
+ * This is the only sort step that compares strings, it runs once per listing
+ * so that re-sorting by any column compares integers only.
+ * @param files Files from the same directory
+ */
+void rankFileNames(std::vector<File*>* files)
+{
+    std::vector<File*> by_name(*files);
+    std::sort(by_name.begin(), by_name.end(), [](File* a, File* b) {
+        if(a->name_key != b->name_key) return a->name_key < b->name_key;
+        int order = a->collate_name.compare(b->collate_name);
+        if(order == 0) order = a->name.compare(b->name);
+        return order < 0;
+    });
+    for(int i = 0; i < by_name.size(); i++)
+    {
+        by_name[i]->name_rank = i;
+    }
+}
+
+/** Sorts one directory's files in place
+ * Directories always come first and ties on the column are broken by name,
+ * using the keys computed when the files were loaded.
+ * @param files Files to sort
+ * @param column Column to sort by
+ * @param descending Reverse the column's order
+ */
+void sortFileVector(std::vector<File*>* files, SortColumn column, bool descending)
+{
+    std::vector<SortEntry> entries;
+    entries.reserve(files->size());
+    for(int i = 0; i < files->size(); i++)
+    {
+        entries.push_back(makeSortEntry((*files)[i], i, column, descending));
+    }
+    if(entries.size() < RADIX_SORT_THRESHOLD) std::stable_sort(entries.begin(), entries.end(), sortEntryBefore);
+    else radixSortEntries(&entries);
+    std::vector<File*> sorted(files->size());
+    for(int i = 0; i < entries.size(); i++)
+    {
+        sorted[i] = (*files)[entries[i].index];
+    }
+    files->swap(sorted);
+}
+
+/** Checks whether a file sorts before another under a column
+ */
+bool fileComesBefore(File* a, File* b, SortColumn column, bool descending)
+{
+    return sortEntryBefore(makeSortEntry(a, 0, column, descending), makeSortEntry(b, 1, column, descending));
+}
+
+/** Re-sorts every loaded row, each expanded directory among its own siblings
+ * Uses the keys stored on the files, nothing is rescanned or stat'ed again.
+ * @param renderer Main-stage renderer
+ * @param data AppData
+ * @param column Column to sort by
+ * @param descending Reverse the column's order
+ */
+void sortFiles(SDL_Renderer* renderer, AppData* data, SortColumn column, bool descending)
+{
+    data->sort_column = column;
+    data->sort_descending = descending;
+
+    std::vector<File*> top_level;
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        if(data->files[i]->depth == 0) top_level.push_back(data->files[i]);
+    }
+    sortExpandedFiles(&top_level, column, descending);
+
+    std::vector<File*> rows;
+    rows.reserve(data->files.size());
+    flattenFiles(&rows, top_level);
+    data->files.swap(rows);
+
+    updateColumnHeaders(renderer, data);
+}
+
+/** Sorts a list of files and, recursively, the contents of the expanded ones
+ */
+void sortExpandedFiles(std::vector<File*>* files, SortColumn column, bool descending)
+{
+    sortFileVector(files, column, descending);
+    for(int i = 0; i < files->size(); i++)
+    {
+        if(files->at(i)->is_expanded) sortExpandedFiles(&files->at(i)->sub_files, column, descending);
+    }
+}
+
+/** Appends files to the row list, each followed by its expanded contents
+ */
+void flattenFiles(std::vector<File*>* rows, const std::vector<File*>& files)
+{
+    for(int i = 0; i < files.size(); i++)
+    {
+        rows->push_back(files[i]);
+        if(files[i]->is_expanded) flattenFiles(rows, files[i]->sub_files);
+    }
+}
+
+/** Rebuilds the column header labels, marking the sorted column with ^ or v
+ */
+void updateColumnHeaders(SDL_Renderer* renderer, AppData* data)
+{
+    const char* labels[NUM_SORT_COLUMNS] = {"Type", "Name", "Modified", "Size", "Permissions"};
+    for(int i = 0; i < NUM_SORT_COLUMNS; i++)
+    {
+        std::string label = labels[i];
+        if(i == (int) data->sort_column) label += data->sort_descending ? " v" : " ^";
+        data->HeaderText[i] = label;
+        data->Header_rects[i].w = measureText(label);
+    }
+}
+
+
+// ─── LAZY METADATA ──────────────────────────────────────────────────────────────
+
+
+/** Queues stats for the rows on screen and a few pages around them
+ * Visible rows go first, then rows ordered by their distance from the screen,
+ * so scrolling in either direction finds its metadata ready.
+ */
+void scheduleVisibleStats(AppData* data)
+{
+    int first = data->scroll_offset / FILE_HEIGHT;
+    int last = (data->scroll_offset + data->page_height) / FILE_HEIGHT;
+    int lookahead = (data->page_height / FILE_HEIGHT) * STATQUEUE_LOOKAHEAD_PAGES;
+    if(last >= (int) data->files.size()) last = (int) data->files.size() - 1;
+
+    std::vector<File*> wanted;
+    for(int i = first; i <= last; i++)
+    {
+        if(!data->files[i]->has_stat) wanted.push_back(data->files[i]);
+    }
+    for(int distance = 1; distance <= lookahead; distance++)
+    {
+        int below = last + distance;
+        int above = first - distance;
+        if(below < data->files.size() && !data->files[below]->has_stat) wanted.push_back(data->files[below]);
+        if(above >= 0 && !data->files[above]->has_stat) wanted.push_back(data->files[above]);
+    }
+    scheduleStats(wanted);
+}
+
+/** Applies landed stats, the affected rows show their new columns on the next frame
+ */
+void statHandler(SDL_Renderer* renderer, AppData* data)
+{
+    collectStatResults();
+}
+
+/** Frees every row
+ * data->files holds expanded contents too, so each file is freed exactly once.
+ */
+void freeRows(AppData *data)
+{
+    freeItemVector(&data->files);
+    data->files.clear();
+}
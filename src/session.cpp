@@ -0,0 +1,495 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "session.h"
+
+// On-disk layout: header, rows[row_count], dirs[dir_count], then the string
+// table. The string table starts with the current path; names and directory
+// paths point into it. All integers are in host byte order, the file is a
+// per-machine cache.
+typedef struct SessionHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t row_count;
+    uint32_t dir_count;
+    int32_t scroll_offset;
+    uint8_t sort_column;
+    uint8_t sort_descending;
+    uint8_t reserved[2];
+    uint32_t path_length;
+    uint64_t strings_size;
+} SessionHeader;
+
+typedef struct SessionRow {
+    uint64_t size_bytes;
+    int64_t mtime;
+    uint32_t mode;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t name_rank;
+    // Index of the row this one is listed under, SESSION_NO_PARENT at depth 0
+    uint32_t parent;
+    uint16_t depth;
+    uint8_t flags;
+    uint8_t reserved[1];
+} SessionRow;
+
+typedef struct SessionDirRecord {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t path_offset;
+    uint32_t path_length;
+} SessionDirRecord;
+
+static_assert(sizeof(SessionHeader) == 40, "SessionHeader layout changed");
+static_assert(sizeof(SessionRow) == 40, "SessionRow layout changed");
+static_assert(sizeof(SessionDirRecord) == 24, "SessionDirRecord layout changed");
+
+#define SESSION_ROW_DIR 0x1
+#define SESSION_ROW_EXPANDED 0x2
+#define SESSION_ROW_STAT 0x4
+#define SESSION_NO_PARENT 0xFFFFFFFF
+
+static std::thread revalidator;
+static std::atomic<bool> revalidation_stop(false);
+static std::mutex stale_mutex;
+static std::deque<std::string> stale_dirs;
+
+static uint32_t addString(std::string* strings, std::string str);
+static bool makeParentDirectories(std::string path);
+static bool readSessionHeader(const char* bytes, size_t length, SessionHeader* header);
+static File* decodeSessionRow(SessionState* state, uint32_t index);
+
+
+// ─── SAVE ───────────────────────────────────────────────────────────────────────
+
+
+/** Gets the path of the session snapshot
+ * @return $XDG_CACHE_HOME/fileexplorer/session.bin, falling back to ~/.cache
+ */
+std::string getSessionPath()
+{
+    char *cache_home = getenv("XDG_CACHE_HOME");
+    if(cache_home != NULL && cache_home[0] != '\0')
+    {
+        return std::string(cache_home) + "/fileexplorer/session.bin";
+    }
+    char *home = getenv("HOME");
+    if(home == NULL) return "";
+    return std::string(home) + "/.cache/fileexplorer/session.bin";
+}
+
+/** Writes the current view to a snapshot file
+ * The file is written next to the old one and renamed over it, so a crash
+ * never leaves a half-written snapshot behind.
+ * @param data AppData holding the rows to save
+ * @param session_path Where to write the snapshot
+ * @return True if the snapshot was written
+ */
+bool saveSession(AppData* data, std::string session_path)
+{
+    if(session_path == "" || !makeParentDirectories(session_path)) return false;
+
+    std::string strings;
+    std::string path = (data->PathText == "") ? "/" : data->PathText;
+    addString(&strings, path);
+
+    std::vector<SessionRow> rows;
+    std::vector<SessionDirRecord> dirs;
+    rows.reserve(data->files.size());
+    // ancestors[d] is the index of the latest saved row at depth d
+    std::vector<uint32_t> ancestors;
+
+    SessionDirRecord root_dir;
+    memset(&root_dir, 0, sizeof(root_dir));
+    root_dir.path_offset = 0;
+    root_dir.path_length = path.size();
+    dirs.push_back(root_dir);
+
+    for(int i = 0; i < data->files.size(); i++)
+    {
+        File* file = data->files[i];
+        // Archives are saved collapsed, their members are listed again from the index when expanded
+        if(isArchiveMember(file)) continue;
+        bool expanded = file->is_expanded && file->archive == "";
+        SessionRow row;
+        memset(&row, 0, sizeof(row));
+        row.size_bytes = file->size_bytes;
+        row.mtime = file->mtime;
+        row.mode = file->mode;
+        row.name_length = file->name.size();
+        row.name_offset = addString(&strings, file->name);
+        row.name_rank = file->name_rank;
+        row.parent = (file->depth > 0) ? ancestors[file->depth - 1] : SESSION_NO_PARENT;
+        row.depth = file->depth;
+        row.flags = (file->is_dir ? SESSION_ROW_DIR : 0) | (expanded ? SESSION_ROW_EXPANDED : 0) | (file->has_stat ? SESSION_ROW_STAT : 0);
+        ancestors.resize(file->depth);
+        ancestors.push_back(rows.size());
+        rows.push_back(row);
+
+        if(expanded)
+        {
+            SessionDirRecord dir;
+            memset(&dir, 0, sizeof(dir));
+            dir.path_length = file->path.size();
+            dir.path_offset = addString(&strings, file->path);
+            dirs.push_back(dir);
+        }
+    }
+
+    // Directory mtimes are what the next start compares against
+    for(int i = 0; i < dirs.size(); i++)
+    {
+        struct stat info;
+        std::string dir_path = strings.substr(dirs[i].path_offset, dirs[i].path_length);
+        if(stat(dir_path.c_str(), &info) == 0)
+        {
+            dirs[i].mtime_sec = info.st_mtim.tv_sec;
+            dirs[i].mtime_nsec = info.st_mtim.tv_nsec;
+        }
+    }
+
+    SessionHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+    header.version = SESSION_VERSION;
+    header.row_count = rows.size();
+    header.dir_count = dirs.size();
+    header.scroll_offset = data->scroll_offset;
+    header.sort_column = (uint8_t) data->sort_column;
+    header.sort_descending = data->sort_descending;
+    header.path_length = path.size();
+    header.strings_size = strings.size();
+
+    std::string temp_path = session_path + ".tmp";
+    FILE* out = fopen(temp_path.c_str(), "wb");
+    if(out == NULL)
+    {
+        printf("Error: %s: %s\n", temp_path.c_str(), strerror(errno));
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    if(ok && !rows.empty()) ok = fwrite(rows.data(), sizeof(SessionRow), rows.size(), out) == rows.size();
+    if(ok) ok = fwrite(dirs.data(), sizeof(SessionDirRecord), dirs.size(), out) == dirs.size();
+    if(ok) ok = fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+    if(fclose(out) != 0) ok = false;
+
+    if(!ok || rename(temp_path.c_str(), session_path.c_str()) != 0)
+    {
+        printf("Error: could not save session to %s\n", session_path.c_str());
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+// ─── LOAD ───────────────────────────────────────────────────────────────────────
+
+
+/** Maps a snapshot and decodes the rows that were on screen
+ * Only the rows in the saved scroll window, and the directories they are
+ * listed under, are turned into files, so the first frame costs the same
+ * however many rows were saved. The snapshot stays mapped for finishSession.
+ * @param session_path Snapshot to read
+ * @param page_height Height of the file list, to know which rows are on screen
+ * @param state Filled in with the saved view, the rows off screen are NULL
+ * @return False if there is no usable snapshot
+ */
+bool loadSession(std::string session_path, int page_height, SessionState* state)
+{
+    state->snapshot = NULL;
+    state->snapshot_length = 0;
+    if(session_path == "") return false;
+    int fd = open(session_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(SessionHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t length = info.st_size;
+    void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return false;
+    const char* bytes = (const char*) mapping;
+
+    SessionHeader header;
+    if(!readSessionHeader(bytes, length, &header))
+    {
+        munmap(mapping, length);
+        return false;
+    }
+    const char* strings = bytes + length - header.strings_size;
+
+    state->path = std::string(strings, header.path_length);
+    state->sort_column = (SortColumn) header.sort_column;
+    state->sort_descending = header.sort_descending != 0;
+    state->rows.assign(header.row_count, NULL);
+    state->dirs.clear();
+    state->snapshot = bytes;
+    state->snapshot_length = length;
+
+    // The same clamping the view applies once every row is there
+    int64_t max_scroll = (int64_t) header.row_count * FILE_HEIGHT - page_height;
+    state->scroll_offset = (int) std::max<int64_t>(0, std::min<int64_t>(header.scroll_offset, max_scroll));
+    uint32_t first = state->scroll_offset / FILE_HEIGHT;
+    // Rows are drawn down to the bottom of the window, under the status bar too
+    uint32_t last = std::min<uint64_t>(header.row_count, (uint64_t) first + HEIGHT / FILE_HEIGHT + 1);
+    for(uint32_t i = first; i < last; i++)
+    {
+        if(decodeSessionRow(state, i) != NULL) continue;
+        printf("Error: ignoring corrupt session %s\n", session_path.c_str());
+        discardSession(state);
+        return false;
+    }
+    return true;
+}
+
+/** Decodes the rows loadSession left out and links every row into its parent's sub_files
+ * Runs once the first frame is on screen. The snapshot is unmapped afterwards.
+ * @param state State filled in by loadSession
+ * @return False if the snapshot turned out to be corrupt, every row is freed then
+ */
+bool finishSession(SessionState* state)
+{
+    if(state->snapshot == NULL) return true;
+    SessionHeader header;
+    memcpy(&header, state->snapshot, sizeof(header));
+    const char* strings = state->snapshot + state->snapshot_length - header.strings_size;
+    const char* dir_records = strings - (uint64_t) header.dir_count * sizeof(SessionDirRecord);
+
+    // parents[d] is the latest row at depth d, the parent of the next row at d + 1
+    std::vector<File*> parents;
+    bool valid = true;
+    for(uint32_t i = 0; i < header.row_count && valid; i++)
+    {
+        File* file = decodeSessionRow(state, i);
+        // Rows must come parents first, each right below its parent's earlier contents
+        if(file == NULL || file->depth > parents.size())
+        {
+            valid = false;
+            break;
+        }
+        SessionRow row;
+        memcpy(&row, state->snapshot + sizeof(SessionHeader) + (uint64_t) i * sizeof(SessionRow), sizeof(row));
+        File* parent = (file->depth > 0) ? parents[file->depth - 1] : NULL;
+        if(parent != NULL && state->rows[row.parent] != parent)
+        {
+            valid = false;
+            break;
+        }
+        if(parent != NULL) parent->sub_files.push_back(file);
+        parents.resize(file->depth);
+        parents.push_back(file);
+    }
+
+    for(uint32_t i = 0; i < header.dir_count && valid; i++)
+    {
+        SessionDirRecord record;
+        memcpy(&record, dir_records + (uint64_t) i * sizeof(SessionDirRecord), sizeof(record));
+        if((uint64_t) record.path_offset + record.path_length > header.strings_size)
+        {
+            valid = false;
+            break;
+        }
+        SessionDir dir;
+        dir.path = std::string(strings + record.path_offset, record.path_length);
+        dir.mtime_sec = record.mtime_sec;
+        dir.mtime_nsec = record.mtime_nsec;
+        state->dirs.push_back(dir);
+    }
+
+    if(!valid)
+    {
+        printf("Error: ignoring corrupt session\n");
+        discardSession(state);
+        return false;
+    }
+    munmap((void*) state->snapshot, state->snapshot_length);
+    state->snapshot = NULL;
+    return true;
+}
+
+/** Frees the decoded rows and unmaps the snapshot, for a session that won't be shown
+ */
+void discardSession(SessionState* state)
+{
+    // Nothing was scheduled for these rows yet, they are only in this list
+    for(int i = 0; i < state->rows.size(); i++)
+    {
+        delete state->rows[i];
+    }
+    state->rows.clear();
+    state->dirs.clear();
+    if(state->snapshot != NULL) munmap((void*) state->snapshot, state->snapshot_length);
+    state->snapshot = NULL;
+}
+
+/** Checks a snapshot's header and that its sections fit the file
+ */
+static bool readSessionHeader(const char* bytes, size_t length, SessionHeader* header)
+{
+    memcpy(header, bytes, sizeof(*header));
+    uint64_t rows_offset = sizeof(SessionHeader);
+    uint64_t dirs_offset = rows_offset + (uint64_t) header->row_count * sizeof(SessionRow);
+    uint64_t strings_offset = dirs_offset + (uint64_t) header->dir_count * sizeof(SessionDirRecord);
+    return memcmp(header->magic, SESSION_MAGIC, sizeof(header->magic)) == 0 && header->version == SESSION_VERSION &&
+           strings_offset <= length && header->strings_size == length - strings_offset &&
+           header->path_length <= header->strings_size &&
+           header->sort_column < NUM_SORT_COLUMNS;
+}
+
+/** Turns one saved row into a file, decoding the rows it is listed under first
+ * @param state State filled in by loadSession
+ * @param index Index of the row in the snapshot
+ * @return The row, or NULL if the snapshot is corrupt
+ */
+static File* decodeSessionRow(SessionState* state, uint32_t index)
+{
+    SessionHeader header;
+    memcpy(&header, state->snapshot, sizeof(header));
+    const char* strings = state->snapshot + state->snapshot_length - header.strings_size;
+
+    // Walk up to the nearest row that is already decoded, then decode back down
+    std::vector<SessionRow> chain;
+    std::vector<uint32_t> indexes;
+    File* parent = NULL;
+    for(uint32_t i = index; state->rows[i] == NULL; )
+    {
+        SessionRow row;
+        memcpy(&row, state->snapshot + sizeof(SessionHeader) + (uint64_t) i * sizeof(SessionRow), sizeof(row));
+        if((uint64_t) row.name_offset + row.name_length > header.strings_size) return NULL;
+        chain.push_back(row);
+        indexes.push_back(i);
+        if(row.depth == 0)
+        {
+            if(row.parent != SESSION_NO_PARENT) return NULL;
+            break;
+        }
+        // Parents are saved before their contents, this also ends any loop
+        if(row.parent >= i) return NULL;
+        i = row.parent;
+        parent = state->rows[i];
+    }
+    if(chain.empty()) return state->rows[index];
+
+    for(int i = chain.size() - 1; i >= 0; i--)
+    {
+        const SessionRow& row = chain[i];
+        if(parent != NULL && (parent->depth != row.depth - 1 || !parent->is_expanded)) return NULL;
+        if(parent == NULL && row.depth != 0) return NULL;
+
+        std::string name(strings + row.name_offset, row.name_length);
+        File* file = createLazyFileEntry(parent ? parent->path : state->path, name, row.depth, (row.flags & SESSION_ROW_DIR) != 0);
+        file->is_expanded = (row.flags & SESSION_ROW_EXPANDED) != 0;
+        file->name_rank = row.name_rank;
+        if(row.flags & SESSION_ROW_STAT)
+        {
+            struct stat saved;
+            memset(&saved, 0, sizeof(saved));
+            saved.st_mode = row.mode;
+            saved.st_size = row.size_bytes;
+            saved.st_mtime = row.mtime;
+            applyFileStat(file, &saved);
+        }
+        state->rows[indexes[i]] = file;
+        parent = file;
+    }
+    return state->rows[index];
+}
+
+
+// ─── REVALIDATION ───────────────────────────────────────────────────────────────
+
+
+/** Checks the restored directories against the disk on a background thread
+ * Every directory whose mtime changed since the snapshot is reported through
+ * popStaleDirectory, and notify_event is pushed so the view can refresh it.
+ * @param dirs Directories from the snapshot
+ * @param notify_event SDL event type pushed for each stale directory
+ */
+void startSessionRevalidation(std::vector<SessionDir> dirs, Uint32 notify_event)
+{
+    revalidation_stop = false;
+    revalidator = std::thread([dirs, notify_event]() {
+        for(int i = 0; i < dirs.size() && !revalidation_stop; i++)
+        {
+            struct stat info;
+            if(stat(dirs[i].path.c_str(), &info) == 0 &&
+               info.st_mtim.tv_sec == dirs[i].mtime_sec && info.st_mtim.tv_nsec == dirs[i].mtime_nsec)
+            {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(stale_mutex);
+                stale_dirs.push_back(dirs[i].path);
+            }
+            SDL_Event event;
+            memset(&event, 0, sizeof(event));
+            event.type = notify_event;
+            SDL_PushEvent(&event);
+        }
+    });
+}
+
+/** Stops the revalidation thread if it is still running
+ */
+void stopSessionRevalidation()
+{
+    revalidation_stop = true;
+    if(revalidator.joinable()) revalidator.join();
+}
+
+/** Takes the next directory that changed since the snapshot
+ * @param path Set to the directory's path
+ * @return False if none are waiting
+ */
+bool popStaleDirectory(std::string* path)
+{
+    std::lock_guard<std::mutex> lock(stale_mutex);
+    if(stale_dirs.empty()) return false;
+    *path = stale_dirs.front();
+    stale_dirs.pop_front();
+    return true;
+}
+
+
+// ─── HELPERS ────────────────────────────────────────────────────────────────────
+
+
+static uint32_t addString(std::string* strings, std::string str)
+{
+    uint32_t offset = strings->size();
+    strings->append(str);
+    return offset;
+}
+
+/** Creates every missing directory above a file path
+ */
+static bool makeParentDirectories(std::string path)
+{
+    for(size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+    {
+        std::string dir = path.substr(0, slash);
+        if(mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+        {
+            printf("Error: %s: %s\n", dir.c_str(), strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,184 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>
+#include <sys/stat.h>
+#include "statqueue.h"
+
+// Files are only touched on the main thread; workers see a ticket and a path,
+// so a file freed while its stat is in flight is never written to.
+typedef struct StatTask {
+    uint64_t ticket;
+    std::string path;
+} StatTask;
+
+typedef struct StatDone {
+    uint64_t ticket;
+    bool ok;
+    struct stat info;
+} StatDone;
+
+static std::vector<std::thread> workers;
+static std::mutex queue_mutex;
+static std::condition_variable queue_cv;
+static std::deque<StatTask> tasks;
+static std::deque<StatDone> done;
+static std::unordered_set<uint64_t> in_flight;
+static bool stopping = false;
+
+static Uint32 notify_event_type;
+static std::atomic<bool> event_pending(false);
+
+// Main thread only
+static std::unordered_map<File*, uint64_t> tickets;
+static std::unordered_map<uint64_t, File*> ticket_files;
+static uint64_t next_ticket = 1;
+
+static void statWorker();
+
+
+/** Starts the stat workers
+ * @param notify_event SDL event type pushed when results are waiting
+ */
+void initStatQueue(Uint32 notify_event)
+{
+    notify_event_type = notify_event;
+    stopping = false;
+    for(int i = 0; i < STATQUEUE_THREADS; i++)
+    {
+        workers.push_back(std::thread(statWorker));
+    }
+}
+
+/** Drops every pending stat and joins the workers
+ */
+void shutdownStatQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    queue_cv.notify_all();
+    for(int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+/** Replaces the pending stats with a new list
+ * Called whenever the view moves, so the queue always follows the scroll
+ * position. Files no longer wanted are dropped unless a worker already has them.
+ * @param wanted Files missing metadata, most urgent first
+ */
+void scheduleStats(std::vector<File*> wanted)
+{
+    std::deque<StatTask> new_tasks;
+    for(int i = 0; i < wanted.size(); i++)
+    {
+        File* file = wanted[i];
+        auto it = tickets.find(file);
+        uint64_t ticket;
+        if(it != tickets.end())
+        {
+            ticket = it->second;
+        }
+        else
+        {
+            ticket = next_ticket++;
+            tickets[file] = ticket;
+            ticket_files[ticket] = file;
+        }
+        StatTask task;
+        task.ticket = ticket;
+        task.path = file->path;
+        new_tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        tasks.clear();
+        for(int i = 0; i < new_tasks.size(); i++)
+        {
+            if(in_flight.count(new_tasks[i].ticket) == 0) tasks.push_back(new_tasks[i]);
+        }
+    }
+    queue_cv.notify_all();
+}
+
+/** Forgets a file that is about to be freed, its result will be discarded
+ */
+void forgetFileStat(File* file)
+{
+    auto it = tickets.find(file);
+    if(it == tickets.end()) return;
+    ticket_files.erase(it->second);
+    tickets.erase(it);
+}
+
+/** Applies every finished stat to its file
+ * @return How many files received metadata
+ */
+int collectStatResults()
+{
+    event_pending = false;
+    std::deque<StatDone> finished;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        finished.swap(done);
+    }
+
+    int updated = 0;
+    for(int i = 0; i < finished.size(); i++)
+    {
+        auto it = ticket_files.find(finished[i].ticket);
+        if(it == ticket_files.end()) continue;
+        File* file = it->second;
+        ticket_files.erase(it);
+        tickets.erase(file);
+
+        if(!finished[i].ok) memset(&finished[i].info, 0, sizeof(finished[i].info));
+        applyFileStat(file, &finished[i].info);
+        updated++;
+    }
+    return updated;
+}
+
+static void statWorker()
+{
+    while(true)
+    {
+        StatTask task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, []{ return stopping || !tasks.empty(); });
+            if(stopping) return;
+            task = tasks.front();
+            tasks.pop_front();
+            in_flight.insert(task.ticket);
+        }
+
+        StatDone result;
+        result.ticket = task.ticket;
+        result.ok = (stat(task.path.c_str(), &result.info) == 0);
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            in_flight.erase(task.ticket);
+            done.push_back(result);
+        }
+        // One wake-up per batch, the main thread drains everything that landed
+        if(!event_pending.exchange(true))
+        {
+            SDL_Event event;
+            memset(&event, 0, sizeof(event));
+            event.type = notify_event_type;
+            SDL_PushEvent(&event);
+        }
+    }
+}
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "treemap.h"
+#include "workpool.h"
+
+typedef struct FileEntry {
+    std::string name;
+    uint64_t size;
+    Type type;
+} FileEntry;
+
+typedef struct LayoutItem {
+    TreeNode *node;
+    uint64_t size;
+} LayoutItem;
+
+static WorkPool walk_pool;
+static std::atomic<bool> stopping(false);
+
+static TreeNode *root = NULL;
+static std::string root_path;
+static dev_t root_device;
+static std::atomic<uint64_t> files_seen(0);
+static std::atomic<uint64_t> dirs_seen(0);
+static ProgressNotifier notifier;
+
+static void scanDirectory(TreeNode* node);
+static TreeNode* createNode(std::string name, TreeNode* parent, bool is_dir, Type type, uint64_t size);
+static void freeTree(TreeNode* node);
+static void layoutNode(TreeNode* node, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects);
+static void squarify(std::vector<LayoutItem>& items, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects);
+static float worstAspect(float largest, float smallest, float sum, float side);
+static void emitItem(const LayoutItem& item, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects);
+
+
+// ─── WALK ───────────────────────────────────────────────────────────────────────
+
+
+/** Starts summing the disk usage below a directory, replacing any previous walk
+ * Totals are readable while the walk runs and only ever grow, so the view can be
+ * laid out again each time progress is reported without starting over.
+ * @param path Directory at the root of the treemap
+ * @param notify_event SDL event type pushed as totals arrive and when the walk ends
+ */
+void startTreemapWalk(std::string path, Uint32 notify_event)
+{
+    stopTreemapWalk();
+
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        printf("Error: %s\n", strerror(errno ? errno : ENOTDIR));
+        return;
+    }
+
+    initProgressNotifier(&notifier, notify_event, TREEMAP_PROGRESS_INTERVAL_MS);
+    root_path = path;
+    // Like du -x, other filesystems mounted below the root are not entered
+    root_device = info.st_dev;
+    root = createNode(path, NULL, true, Type::DIRECTORY, 0);
+    files_seen = 0;
+    dirs_seen = 0;
+    stopping = false;
+    startWorkPool(&walk_pool, TREEMAP_THREADS, &notifier, []() { scanDirectory(root); });
+}
+
+/** Stops the walk and frees its tree
+ */
+void stopTreemapWalk()
+{
+    stopping = true;
+    stopWorkPool(&walk_pool);
+
+    if(root != NULL) freeTree(root);
+    root = NULL;
+    root_path = "";
+}
+
+/** @return Root of the current walk, or NULL if none was started
+ */
+TreeNode* getTreemapRoot()
+{
+    return root;
+}
+
+/** @return Path the current walk started from
+ */
+std::string getTreemapRootPath()
+{
+    return root_path;
+}
+
+/** Reads the walk's counters
+ * @param progress Filled in with the current totals
+ * @return False if no walk was started
+ */
+bool getTreemapProgress(TreemapProgress* progress)
+{
+    if(root == NULL) return false;
+    progress->files = files_seen;
+    progress->dirs = dirs_seen;
+    progress->bytes = root->size;
+    progress->done = walk_pool.done;
+    return true;
+}
+
+/** Rebuilds the path of a node from its ancestors
+ * @param node Directory or file in the current tree
+ * @return Its path on disk
+ */
+std::string getTreeNodePath(TreeNode* node)
+{
+    if(node->parent == NULL) return node->name;
+    return joinPath(getTreeNodePath(node->parent), node->name);
+}
+
+/** Lists one directory, publishes its children and adds its files' usage to every ancestor
+ * Runs on the walk's pool and queues the subdirectories it finds.
+ * @param node Directory to scan, owned by the calling worker until scanned is set
+ */
+static void scanDirectory(TreeNode* node)
+{
+    std::string path = getTreeNodePath(node);
+    DIR *dir = opendir(path.c_str());
+    if(dir == NULL)
+    {
+        node->scanned.store(true, std::memory_order_release);
+        return;
+    }
+
+    std::vector<TreeNode*> children;
+    std::vector<FileEntry> files;
+    uint64_t total = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if(stopping) break;
+
+        struct stat info;
+        if(fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) continue;
+
+        if(S_ISDIR(info.st_mode))
+        {
+            if(info.st_dev != root_device) continue;
+            children.push_back(createNode(entry->d_name, node, true, Type::DIRECTORY, 0));
+            continue;
+        }
+
+        // Allocated blocks rather than st_size, so sparse files don't look huge
+        FileEntry file;
+        file.name = entry->d_name;
+        file.size = (uint64_t) info.st_blocks * 512;
+        const char *dot = strrchr(entry->d_name, '.');
+        file.type = parseType(false, (info.st_mode & 0111) != 0, (dot == NULL) ? "" : std::string(dot + 1));
+        total += file.size;
+        files.push_back(file);
+    }
+    closedir(dir);
+
+    // The largest files get their own rectangles, the rest are merged by Type
+    std::sort(files.begin(), files.end(), [](const FileEntry& a, const FileEntry& b) { return a.size > b.size; });
+    TreeNode *merged[6] = {NULL, NULL, NULL, NULL, NULL, NULL};
+    for(int i = 0; i < files.size(); i++)
+    {
+        if(i < TREEMAP_MAX_FILES)
+        {
+            children.push_back(createNode(files[i].name, node, false, files[i].type, files[i].size));
+            continue;
+        }
+        TreeNode **bucket = &merged[(int) files[i].type];
+        if(*bucket == NULL)
+        {
+            *bucket = createNode("", node, false, files[i].type, 0);
+            children.push_back(*bucket);
+        }
+        (*bucket)->size += files[i].size;
+        (*bucket)->merged_files++;
+    }
+    for(int i = 0; i < 6; i++)
+    {
+        if(merged[i] != NULL) merged[i]->name = std::to_string(merged[i]->merged_files) + " smaller files";
+    }
+
+    node->children = children;
+    node->scanned.store(true, std::memory_order_release);
+    for(TreeNode *ancestor = node; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        ancestor->size += total;
+    }
+    files_seen += files.size();
+    dirs_seen++;
+
+    for(int i = 0; i < children.size(); i++)
+    {
+        TreeNode *child = children[i];
+        if(child->is_dir) queueWork(&walk_pool, [child]() { scanDirectory(child); }, false);
+    }
+}
+
+static TreeNode* createNode(std::string name, TreeNode* parent, bool is_dir, Type type, uint64_t size)
+{
+    TreeNode *node = new TreeNode();
+    node->name = name;
+    node->parent = parent;
+    node->is_dir = is_dir;
+    node->type = type;
+    node->merged_files = 0;
+    node->size = size;
+    node->scanned = !is_dir;
+    return node;
+}
+
+static void freeTree(TreeNode* node)
+{
+    for(int i = 0; i < node->children.size(); i++)
+    {
+        freeTree(node->children[i]);
+    }
+    delete node;
+}
+
+
+// ─── LAYOUT ─────────────────────────────────────────────────────────────────────
+
+
+/** Lays out a squarified treemap of a directory from its current totals
+ * Only rectangles that are at least a pixel in size are produced and nesting stops
+ * at TREEMAP_MIN_NEST_SIZE, so the cost follows the window size, not the tree size.
+ * Parents are emitted before their children.
+ * @param root Directory filling the whole area
+ * @param area Where to draw it
+ * @param rects Replaced with the rectangles to draw
+ */
+void layoutTreemap(TreeNode* root, SDL_Rect area, std::vector<TreemapRect>* rects)
+{
+    rects->clear();
+    if(root == NULL) return;
+    layoutNode(root, (float) area.x, (float) area.y, (float) area.w, (float) area.h, 0, rects);
+}
+
+/** Finds the directory under a point, the parent directory when the point is on a file
+ * @param rects Result of layoutTreemap
+ * @param x Window x coordinate
+ * @param y Window y coordinate
+ * @return The directory, or NULL if the point is outside the treemap
+ */
+TreeNode* findTreemapDirectory(const std::vector<TreemapRect>& rects, int x, int y)
+{
+    SDL_Point point = {x, y};
+    // Children come after their parents, so the last hit is the deepest one
+    for(int i = (int) rects.size() - 1; i >= 0; i--)
+    {
+        if(!SDL_PointInRect(&point, &rects[i].rect)) continue;
+        TreeNode *node = rects[i].node;
+        return node->is_dir ? node : node->parent;
+    }
+    return NULL;
+}
+
+/** Emits one directory's frame and lays out its children inside it
+ */
+static void layoutNode(TreeNode* node, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects)
+{
+    if(!node->scanned.load(std::memory_order_acquire)) return;
+
+    // Name strip along the top of large directories
+    if(w >= TREEMAP_LABEL_MIN_SIZE && h >= TREEMAP_LABEL_MIN_SIZE)
+    {
+        y += TREEMAP_LABEL_HEIGHT;
+        h -= TREEMAP_LABEL_HEIGHT;
+    }
+    // One pixel of the parent shows around its contents
+    x += 1;
+    y += 1;
+    w -= 2;
+    h -= 2;
+    if(w < 1 || h < 1) return;
+
+    // Sizes are read once, the walker may be growing them while this runs
+    std::vector<LayoutItem> items;
+    uint64_t total = 0;
+    for(int i = 0; i < node->children.size(); i++)
+    {
+        LayoutItem item = {node->children[i], node->children[i]->size.load()};
+        if(item.size == 0) continue;
+        items.push_back(item);
+        total += item.size;
+    }
+    if(total == 0) return;
+    std::sort(items.begin(), items.end(), [](const LayoutItem& a, const LayoutItem& b) { return a.size > b.size; });
+    squarify(items, x, y, w, h, depth + 1, rects);
+}
+
+/** Squarified treemap layout (Bruls, Huizing, van Wijk)
+ * Items are placed in rows along the shorter side of the remaining area, and a
+ * row is closed as soon as adding the next item would make its worst aspect
+ * ratio worse.
+ * @param items Children sorted by size, largest first
+ */
+static void squarify(std::vector<LayoutItem>& items, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects)
+{
+    double total = 0;
+    for(int i = 0; i < items.size(); i++) total += (double) items[i].size;
+    double scale = ((double) w * (double) h) / total;
+
+    size_t start = 0;
+    while(start < items.size() && rects->size() < TREEMAP_MAX_RECTS)
+    {
+        float side = std::min(w, h);
+        if(side < 1) return;
+
+        size_t end = start;
+        float sum = 0;
+        float worst = 0;
+        while(end < items.size())
+        {
+            float area = (float) (items[end].size * scale);
+            float next = worstAspect((float) (items[start].size * scale), area, sum + area, side);
+            if(end > start && next > worst) break;
+            worst = next;
+            sum += area;
+            end++;
+        }
+
+        // Lay the row across the short side, then shrink the remaining area past it
+        float thickness = sum / side;
+        float offset = 0;
+        for(size_t i = start; i < end; i++)
+        {
+            float length = (float) (items[i].size * scale) / thickness;
+            if(w >= h) emitItem(items[i], x, y + offset, thickness, length, depth, rects);
+            else emitItem(items[i], x + offset, y, length, thickness, depth, rects);
+            offset += length;
+        }
+        if(w >= h)
+        {
+            x += thickness;
+            w -= thickness;
+        }
+        else
+        {
+            y += thickness;
+            h -= thickness;
+        }
+        start = end;
+    }
+}
+
+/** Worst aspect ratio in a row, given its largest and smallest areas
+ */
+static float worstAspect(float largest, float smallest, float sum, float side)
+{
+    float side2 = side * side;
+    float sum2 = sum * sum;
+    return std::max((side2 * largest) / sum2, sum2 / (side2 * smallest));
+}
+
+/** Emits a child's rectangle, snapped so neighbours share edges, and nests into directories
+ */
+static void emitItem(const LayoutItem& item, float x, float y, float w, float h, int depth, std::vector<TreemapRect>* rects)
+{
+    int x0 = (int) (x + 0.5f);
+    int y0 = (int) (y + 0.5f);
+    int x1 = (int) (x + w + 0.5f);
+    int y1 = (int) (y + h + 0.5f);
+    if(x1 - x0 < 1 || y1 - y0 < 1) return;
+
+    TreemapRect rect;
+    rect.rect = {x0, y0, x1 - x0, y1 - y0};
+    rect.node = item.node;
+    rect.depth = depth;
+    rects->push_back(rect);
+
+    if(item.node->is_dir && rect.rect.w >= TREEMAP_MIN_NEST_SIZE && rect.rect.h >= TREEMAP_MIN_NEST_SIZE)
+    {
+        layoutNode(item.node, (float) x0, (float) y0, (float) rect.rect.w, (float) rect.rect.h, depth, rects);
+    }
+}
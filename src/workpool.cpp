@@ -0,0 +1,131 @@
+#include <chrono>
+#include <string.h>
+#include "workpool.h"
+
+static void poolWorker(WorkPool* pool);
+
+
+// ─── NOTIFY ─────────────────────────────────────────────────────────────────────
+
+
+/** Sets up a notifier that hasn't pushed anything yet
+ * @param event_type SDL event type to push
+ * @param interval_ms Shortest time between two unforced events
+ */
+void initProgressNotifier(ProgressNotifier* notifier, Uint32 event_type, int interval_ms)
+{
+    notifier->event_type = event_type;
+    notifier->interval_ms = interval_ms;
+    notifier->last_ms = 0;
+}
+
+/** Wakes the main loop, at most once per interval unless forced
+ * Safe to call from any number of threads at once.
+ */
+void notifyProgress(ProgressNotifier* notifier, bool force)
+{
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    long long last = notifier->last_ms;
+    // Only one of the threads racing past the interval gets to push the event
+    if(!force && (now - last < notifier->interval_ms || !notifier->last_ms.compare_exchange_strong(last, now))) return;
+    notifier->last_ms = now;
+
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = notifier->event_type;
+    SDL_PushEvent(&event);
+}
+
+
+// ─── POOL ───────────────────────────────────────────────────────────────────────
+
+
+/** Starts the threads of an idle pool on its first task
+ * @param thread_count Number of workers
+ * @param notifier Pushed after each task and forced once the pool is done, or NULL
+ * @param first_task Runs first, the rest of the work is queued from it
+ */
+void startWorkPool(WorkPool* pool, int thread_count, ProgressNotifier* notifier, std::function<void()> first_task)
+{
+    pool->tasks.clear();
+    pool->deferred.clear();
+    pool->tasks.push_back(first_task);
+    pool->busy = 0;
+    pool->stopping = false;
+    pool->done = false;
+    pool->notifier = notifier;
+    for(int i = 0; i < thread_count; i++)
+    {
+        pool->workers.push_back(std::thread(poolWorker, pool));
+    }
+}
+
+/** Adds a task, called from a running task. Dropped if the pool is stopping.
+ * @param deferred Wait until no other task is queued, so a walk can finish first
+ */
+void queueWork(WorkPool* pool, std::function<void()> task, bool deferred)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if(pool->stopping) return;
+        if(deferred) pool->deferred.push_back(task);
+        else pool->tasks.push_back(task);
+    }
+    pool->cv.notify_one();
+}
+
+/** Waits for the queue to run dry and joins the workers
+ */
+void waitWorkPool(WorkPool* pool)
+{
+    for(int i = 0; i < pool->workers.size(); i++)
+    {
+        pool->workers[i].join();
+    }
+    pool->workers.clear();
+}
+
+/** Drops every queued task, lets the running ones return and joins the workers
+ */
+void stopWorkPool(WorkPool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+        pool->tasks.clear();
+        pool->deferred.clear();
+    }
+    pool->cv.notify_all();
+    waitWorkPool(pool);
+}
+
+/** Takes tasks off the queue until the pool is done or stopped
+ */
+static void poolWorker(WorkPool* pool)
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->cv.wait(lock, [pool]{ return pool->stopping || !pool->tasks.empty() || !pool->deferred.empty() || pool->busy == 0; });
+            if(pool->stopping || (pool->tasks.empty() && pool->deferred.empty() && pool->busy == 0)) return;
+            std::deque<std::function<void()>>* queue = pool->tasks.empty() ? &pool->deferred : &pool->tasks;
+            task = queue->front();
+            queue->pop_front();
+            pool->busy++;
+        }
+
+        task();
+
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->busy--;
+            finished = (pool->tasks.empty() && pool->deferred.empty() && pool->busy == 0 && !pool->stopping);
+            if(finished) pool->done = true;
+        }
+        pool->cv.notify_all();
+        if(pool->notifier != NULL) notifyProgress(pool->notifier, finished);
+    }
+}
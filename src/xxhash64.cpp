@@ -0,0 +1,159 @@
+#include <string.h>
+#include "xxhash64.h"
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// The spec reads input as little-endian words
+static inline uint64_t read64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t mergeRound64(uint64_t acc, uint64_t value)
+{
+    acc ^= round64(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/** Mixes the last (fewer than 32) bytes into the hash and avalanches it
+ */
+static uint64_t finalize64(uint64_t h, const uint8_t* p, size_t length)
+{
+    while(length >= 8)
+    {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        length -= 8;
+    }
+    if(length >= 4)
+    {
+        h ^= (uint64_t) read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        length -= 4;
+    }
+    while(length > 0)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+        length--;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/** Hashes a buffer in one call
+ * @param data Bytes to hash
+ * @param length Number of bytes
+ * @param seed Seed value, 0 for the standard hash
+ * @return The 64-bit hash
+ */
+uint64_t xxh64(const void* data, size_t length, uint64_t seed)
+{
+    XXH64State state;
+    xxh64Reset(&state, seed);
+    xxh64Update(&state, data, length);
+    return xxh64Digest(&state);
+}
+
+/** Prepares a state for a new stream
+ */
+void xxh64Reset(XXH64State* state, uint64_t seed)
+{
+    state->acc[0] = seed + PRIME64_1 + PRIME64_2;
+    state->acc[1] = seed + PRIME64_2;
+    state->acc[2] = seed;
+    state->acc[3] = seed - PRIME64_1;
+    state->seed = seed;
+    state->total_length = 0;
+    state->buffered = 0;
+}
+
+/** Feeds more bytes into a stream, in any chunk sizes
+ */
+void xxh64Update(XXH64State* state, const void* data, size_t length)
+{
+    const uint8_t *p = (const uint8_t*) data;
+    state->total_length += length;
+
+    // Top up a partial stripe left by the previous call
+    if(state->buffered > 0)
+    {
+        size_t take = 32 - state->buffered;
+        if(take > length) take = length;
+        memcpy(state->buffer + state->buffered, p, take);
+        state->buffered += take;
+        p += take;
+        length -= take;
+        if(state->buffered < 32) return;
+        for(int i = 0; i < 4; i++) state->acc[i] = round64(state->acc[i], read64(state->buffer + 8 * i));
+        state->buffered = 0;
+    }
+
+    while(length >= 32)
+    {
+        for(int i = 0; i < 4; i++) state->acc[i] = round64(state->acc[i], read64(p + 8 * i));
+        p += 32;
+        length -= 32;
+    }
+
+    memcpy(state->buffer, p, length);
+    state->buffered = length;
+}
+
+/** Produces the hash of everything fed so far, the state can keep being updated
+ */
+uint64_t xxh64Digest(const XXH64State* state)
+{
+    uint64_t h;
+    if(state->total_length >= 32)
+    {
+        const uint64_t *acc = state->acc;
+        h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+        for(int i = 0; i < 4; i++) h = mergeRound64(h, acc[i]);
+    }
+    else
+    {
+        h = state->seed + PRIME64_5;
+    }
+    h += state->total_length;
+    return finalize64(h, state->buffer, state->buffered);
+}